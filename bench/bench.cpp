@@ -0,0 +1,67 @@
+#include "bench.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace bench
+{
+    BenchRegRecord* benches = nullptr;
+    std::atomic<size_t> allocations{ 0 };
+
+    BenchRegRecord::BenchRegRecord(const char* name, bench_fn fn)
+        : name(name), fn(fn), next(benches) {
+        benches = this;
+    }
+}
+
+void* operator new(size_t size)
+{
+    bench::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// Usage: l_async_bench [name-substring] [min-seconds]
+// Prints one JSON object per benchmark.
+int main(int argc, char* argv[])
+{
+    using clock = std::chrono::steady_clock;
+    const char* filter = argc > 1 ? argv[1] : "";
+    double min_seconds = argc > 2 ? std::atof(argv[2]) : 0.2;
+    for (auto b = bench::benches; b; b = b->next) {
+        if (!std::strstr(b->name, filter))
+            continue;
+        size_t ops = 1;
+        for (;;) {
+            size_t allocs_before = bench::allocations.load(std::memory_order_relaxed);
+            auto start = clock::now();
+            b->fn(ops);
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            size_t allocs = bench::allocations.load(std::memory_order_relaxed) - allocs_before;
+            if (seconds >= min_seconds || ops >= (size_t(1) << 40)) {
+                std::printf(
+                    "{\"name\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f}\n",
+                    b->name, ops, seconds * 1e9 / double(ops), double(allocs) / double(ops));
+                std::fflush(stdout);
+                break;
+            }
+            double scale = seconds > 0 ? min_seconds * 1.2 / seconds : 100;
+            ops = size_t(double(ops) * (scale < 2 ? 2 : scale > 100 ? 100 : scale));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+// Minimal micro-benchmark harness.
+// Each benchmark performs the requested number of operations,
+// the harness reports time and heap allocations per operation as JSON lines.
+
+#include <atomic>
+#include <cstddef>
+
+namespace bench
+{
+    using bench_fn = void (*)(size_t ops);
+
+    struct BenchRegRecord {
+        const char* name;
+        bench_fn fn;
+        BenchRegRecord* next;
+        BenchRegRecord(const char* name, bench_fn fn);
+    };
+
+    // Counted by the replaced global `operator new`.
+    extern std::atomic<size_t> allocations;
+
+    // Prevents the compiler from optimizing away the computation of `value`.
+    template<typename T>
+    void do_not_optimize(T& value)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+}
+
+#define BENCH(NAME, OPS)                                       \
+  static void NAME##_bench(size_t OPS);                        \
+  ::bench::BenchRegRecord NAME##_bench_reg(#NAME, NAME##_bench); \
+  static void NAME##_bench(size_t OPS)
+
+#endif  // _BENCH_H_
@@ -0,0 +1,118 @@
+// Scaling benchmark of the file system scan of `docs/` over synthetic trees of `fake_fs.h`.
+// The target is built with `L_ASYNC_TRACING`, so the tracer counts loops and control blocks; no events are captured.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "fake_fs.h"
+#include "l_async.h"
+#include "l_async_thread_pool.h"
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+using l_async::thread_pool_executor;
+
+namespace
+{
+    struct shape
+    {
+        int fan_out, depth, files_per_dir;
+    };
+
+    // Resets the peak resident set size (Linux only), so each run reports its own peak.
+    // Heap pages kept by malloc after the previous run are returned first.
+    void reset_peak_rss()
+    {
+#if defined(__GLIBC__)
+        malloc_trim(0);
+#endif
+#if defined(__linux__)
+        std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+    }
+
+    // Peak resident set size in KiB since the last reset, 0 if unknown.
+    long peak_rss_kb()
+    {
+#if defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        for (std::string line; std::getline(status, line);) {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+                return std::atol(line.c_str() + 6);
+        }
+#endif
+        return 0;
+    }
+
+    // Runs `scan(callback)` and prints its throughput and peaks; returns false if the total is wrong.
+    template<typename Scan>
+    bool run(const char* name, const shape& s, const fake_tree& tree, Scan scan)
+    {
+        using clock = std::chrono::steady_clock;
+        auto& stats = l_async::trace::recorder::stats();
+        l_async::trace::recorder::reset_peaks();
+        reset_peak_rss();
+        auto start = clock::now();
+        int64_t total = scan();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        std::printf(
+            "{\"name\": \"%s\", \"fan_out\": %d, \"depth\": %d, \"files_per_dir\": %d, \"nodes\": %llu, "
+            "\"seconds\": %.3f, \"nodes_per_sec\": %.0f, \"peak_rss_kb\": %ld, \"peak_loops\": %llu, \"peak_contexts\": %llu, \"peak_context_kb\": %llu}\n",
+            name, s.fan_out, s.depth, s.files_per_dir, (unsigned long long)tree.nodes(),
+            seconds, double(tree.nodes()) / seconds, peak_rss_kb(), (unsigned long long)stats.loops_peak.load(),
+            (unsigned long long)stats.contexts_peak.load(), (unsigned long long)stats.context_bytes_peak.load() / 1024);
+        std::fflush(stdout);
+        if (total == tree.total_size())
+            return true;
+        std::fprintf(stderr, "%s: total %lld, expected %lld\n", name, (long long)total, (long long)tree.total_size());
+        return false;
+    }
+
+    bool run_all(const shape& s, size_t threads)
+    {
+        auto tree = fake_tree::uniform(s.fan_out, s.depth, s.files_per_dir);
+        bool ok = run("sync", s, tree, [&] {
+            return int64_t(calc_tree_size_sync(fake_sync_dir{ tree, 0 }));
+        });
+        ok &= run("async_single_thread", s, tree, [&] {
+            executor ex;
+            int64_t total = -1;
+            calc_tree_size_async(fake_async_dir<executor>{ tree, 0, ex }, [&](int size) { total = size; });
+            ex.execute();
+            return total;
+        });
+        std::string pool_name = "async_thread_pool_" + std::to_string(threads);
+        ok &= run(pool_name.c_str(), s, tree, [&] {
+            thread_pool_executor pool(threads);
+            std::atomic<int64_t> total{ -1 };
+            calc_tree_size_parallel(fake_async_dir<thread_pool_executor>{ tree, 0, pool }, pool, [&](int size) { total = size; });
+            pool.execute();
+            return total.load();
+        });
+        return ok;
+    }
+}
+
+// Usage: l_async_fs_bench [fan-out depth files-per-dir [threads]]
+// Without arguments runs the curve of trees with 10 subdirectories and 9 files per dir from 10^3 to 10^6 nodes,
+// `l_async_fs_bench 10 6 9` scans 10^7 nodes. Prints one JSON object per scan, the thread pool runs on all cores by default.
+int main(int argc, char* argv[])
+{
+    size_t threads = argc > 4 ? size_t(std::atoi(argv[4])) : std::thread::hardware_concurrency();
+    bool ok = true;
+    if (argc > 3) {
+        ok = run_all({ std::atoi(argv[1]), std::atoi(argv[2]), std::atoi(argv[3]) }, threads);
+    } else {
+        for (int depth = 2; depth <= 5; depth++)
+            ok &= run_all({ 10, depth, 9 }, threads);
+    }
+    return ok ? 0 : 1;
+}
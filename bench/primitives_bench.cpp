@@ -0,0 +1,289 @@
+#include <thread>
+#include <vector>
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include "bench.h"
+using bench::do_not_optimize;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "l_async.h"
+#include "l_async_streams.h"
+#include "l_async_thread_pool.h"
+#include "l_async_timer.h"
+using l_async::loop;
+using l_async::result;
+using l_async::slot;
+
+namespace
+{
+    // One op is one loop construction with the immediate termination.
+    BENCH(loop_create, ops)
+    {
+        for (size_t i = 0; i < ops; i++) {
+            loop once([&i](auto) { do_not_optimize(i); });
+        }
+    }
+
+    // One op is one loop construction in a per-request arena.
+    BENCH(loop_create_arena, ops)
+    {
+        l_async::arena request_arena(64 * 1024);
+        l_async::arena_allocator<char> alloc(request_arena);
+        for (size_t i = 0; i < ops; i++) {
+            loop once(std::allocator_arg, alloc, [&i](auto) { do_not_optimize(i); });
+        }
+    }
+
+    // One op is one synchronous restart of the loop body.
+    BENCH(loop_sync_restart, ops)
+    {
+        loop counting([ops, i = size_t(0)](auto next) mutable {
+            do_not_optimize(i);
+            if (++i < ops)
+                next();
+        });
+    }
+
+    // The same with non-atomic reference counts and restart flag.
+    BENCH(loop_sync_restart_local, ops)
+    {
+        l_async::local_loop counting([ops, i = size_t(0)](auto next) mutable {
+            do_not_optimize(i);
+            if (++i < ops)
+                next();
+        });
+    }
+
+    // One op is one loop iteration scheduled through an executor.
+    BENCH(loop_async_iteration, ops)
+    {
+        executor ex;
+        loop counting([&ex, ops, i = size_t(0)](auto next) mutable {
+            if (++i < ops)
+                ex.schedule(next);
+        });
+        ex.execute();
+    }
+
+    template<typename Policy>
+    void result_fan_in_16_with(size_t ops)
+    {
+        executor ex;
+        int total = 0;
+        for (size_t i = 0; i < ops; i++) {
+            result<int, Policy> r([&](int v) { total += v; });
+            for (int branch = 0; branch < 16; branch++) {
+                ex.schedule([r]() mutable { *r += 1; });
+            }
+            ex.execute();
+        }
+        do_not_optimize(total);
+    }
+
+    // One op is one `result` joining 16 parallel branches.
+    BENCH(result_fan_in_16, ops)
+    {
+        result_fan_in_16_with<l_async::multi_threaded>(ops);
+    }
+
+    // The same with non-atomic reference counts.
+    BENCH(result_fan_in_16_local, ops)
+    {
+        result_fan_in_16_with<l_async::single_threaded>(ops);
+    }
+
+    // One op is one `fallible_result` joining 16 branches that succeed, compare with `result_fan_in_16`.
+    BENCH(fallible_result_fan_in_16, ops)
+    {
+        executor ex;
+        int total = 0;
+        for (size_t i = 0; i < ops; i++) {
+            l_async::fallible_result<int> r([&](int v, std::exception_ptr) { total += v; });
+            for (int branch = 0; branch < 16; branch++) {
+                ex.schedule([r]() mutable {
+                    if (!r.failed())
+                        *r += 1;
+                });
+            }
+            ex.execute();
+        }
+        do_not_optimize(total);
+    }
+
+    // One op is one `scope` joining 16 parallel branches, compare with `result_fan_in_16`.
+    BENCH(scope_fan_in_16, ops)
+    {
+        executor ex;
+        int total = 0;
+        for (size_t i = 0; i < ops; i++) {
+            l_async::scope s([&](std::exception_ptr) { total += 16; });
+            for (int branch = 0; branch < 16; branch++) {
+                ex.schedule([child = s.enter()] {});
+            }
+            ex.execute();
+        }
+        do_not_optimize(total);
+    }
+
+    // One op is one `result<pair>` filled by two setters.
+    BENCH(result_setter_pair, ops)
+    {
+        int total = 0;
+        for (size_t i = 0; i < ops; i++) {
+            result<std::pair<int, int>> r([&](auto v) { total += v.first + v.second; });
+            l_async::unique_function<void(int)> a(r.setter(r->first));
+            l_async::unique_function<void(int)> b(r.setter(r->second));
+            a(1);
+            b(2);
+        }
+        do_not_optimize(total);
+    }
+
+    // One op is one `join<int, int>` filled by its two setters.
+    BENCH(join_pair, ops)
+    {
+        int total = 0;
+        for (size_t i = 0; i < ops; i++) {
+            l_async::join<int, int> j([&](int a, int b) { total += a + b; });
+            l_async::unique_function<void(int)> a(j.get<0>());
+            l_async::unique_function<void(int)> b(j.get<1>());
+            a(1);
+            b(2);
+        }
+        do_not_optimize(total);
+    }
+
+    template<typename Policy>
+    void slot_ping_pong_with(size_t ops)
+    {
+        using loop_t = l_async::basic_loop<void, Policy>;
+        slot<optional<size_t>, Policy> numbers;
+        loop_t providing([sink = numbers.get_provider(), i = size_t(0)](auto next) mutable {
+            sink.await([&, next] {
+                sink(i++);
+                next();
+            });
+        });
+        loop_t consuming([numbers, ops](auto next) mutable {
+            numbers([&, next](auto v) {
+                if (*v + 1 < ops)
+                    next();
+            });
+        });
+    }
+
+    // One op is one request/response handoff through a `slot`.
+    BENCH(slot_ping_pong, ops)
+    {
+        slot_ping_pong_with<l_async::multi_threaded>(ops);
+    }
+
+    // The same with non-atomic reference counts of the slot, its provider and loops.
+    BENCH(slot_ping_pong_local, ops)
+    {
+        slot_ping_pong_with<l_async::single_threaded>(ops);
+    }
+
+    // One op is one handoff to a waiting consumer from a provider answering inline (the synchronous fast path).
+    BENCH(slot_sync_handoff, ops)
+    {
+        slot<size_t> numbers;
+        auto sink = numbers.get_provider();
+        size_t total = 0;
+        for (size_t i = 0; i < ops; i++) {
+            numbers([&total](size_t v) { total += v; });
+            sink.await([&sink, i] { sink(i); });
+        }
+        do_not_optimize(total);
+    }
+
+    // Source of `0, 1, ... ops - 1` numbers over a `slot`, consumed synchronously.
+    slot<optional<size_t>> numbers_slot(size_t ops)
+    {
+        slot<optional<size_t>> numbers;
+        loop providing([sink = numbers.get_provider(), ops, i = size_t(0)](auto next) mutable {
+            sink.await([&, next] {
+                sink(i < ops ? optional<size_t>(i++) : nullopt);
+                next();
+            });
+        });
+        return numbers;
+    }
+
+    // One op is one item passed through one hand-written mapping stage over a `slot`.
+    BENCH(stream_hand_written_stage, ops)
+    {
+        auto numbers = numbers_slot(ops);
+        auto stage = [numbers](l_async::unique_function<void(optional<size_t>)> callback) mutable {
+            numbers([callback = std::move(callback)](optional<size_t> v) mutable {
+                callback(v ? optional<size_t>(*v * 3) : nullopt);
+            });
+        };
+        size_t total = 0;
+        l_async::streams::for_each(l_async::streams::as_stream<size_t>(std::move(stage)), [&](size_t v) { total += v; }, [] {});
+        do_not_optimize(total);
+    }
+
+    // One op is one item passed through 5 fused stages over a `slot`, compare with `stream_hand_written_stage`.
+    BENCH(stream_fused_5_stages, ops)
+    {
+        namespace streams = l_async::streams;
+        auto pipeline = numbers_slot(ops)
+            | streams::map([](size_t v) { return v + 1; })
+            | streams::filter([](size_t v) { return v != 0; })
+            | streams::map([](size_t v) { return v * 3; })
+            | streams::take(ops)
+            | streams::map([](size_t v) { return v - 3; });
+        size_t total = 0;
+        streams::for_each(std::move(pipeline), [&](size_t v) { total += v; }, [] {});
+        do_not_optimize(total);
+    }
+
+    // One op is one timer inserted into a wheel and cancelled later, all `ops` timers are pending at once.
+    BENCH(timer_insert_cancel, ops)
+    {
+        using std::chrono::milliseconds;
+        auto origin = l_async::timer_wheel::clock::now();
+        l_async::timer_wheel wheel(milliseconds(1), origin);
+        std::vector<l_async::timer_wheel::timer_id> ids(ops);
+        for (size_t i = 0; i < ops; i++)
+            ids[i] = wheel.at(origin + milliseconds(i * 7919 % 1000000 + 1), [] {});
+        for (size_t i = 0; i < ops; i++)
+            wheel.cancel(ids[i]);
+        do_not_optimize(wheel);
+    }
+
+    // One op is one task posted from another thread to `single_thread_executor` and executed.
+    BENCH(executor_post, ops)
+    {
+        executor ex;
+        size_t done = 0;
+        std::thread io([&] {
+            for (size_t i = 0; i < ops; i++)
+                ex.post([&done] { done++; });
+        });
+        while (done < ops) {
+            ex.wait();
+            ex.execute();
+        }
+        io.join();
+    }
+
+    // One op is one loop iteration scheduled from a worker of `thread_pool_executor`.
+    BENCH(thread_pool_loop_iteration, ops)
+    {
+        l_async::thread_pool_executor pool(2);
+        pool.schedule([&pool, ops] {
+            loop counting([&pool, ops, i = size_t(0)](auto next) mutable {
+                if (++i < ops)
+                    pool.schedule(next);
+            });
+        });
+        pool.execute();
+    }
+}
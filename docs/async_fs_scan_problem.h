@@ -7,11 +7,25 @@ using std::function;
 #include <memory>
 using std::unique_ptr;
 
+#include <vector>
+using std::vector;
+
 template <typename T>
 struct async_stream
 {
     virtual ~async_stream() = default;
     virtual void next(function<void(unique_ptr<T>)> callback) = 0;  // calls callback with nullptr on list end
+
+    // calls callback with up to `max` items (like getdents64 does), an empty batch means list end
+    virtual void get_next_batch(size_t /*max*/, function<void(vector<unique_ptr<T>>)> callback)
+    {
+        next([callback = std::move(callback)](unique_ptr<T> item) {
+            vector<unique_ptr<T>> batch;
+            if (item)
+                batch.push_back(std::move(item));
+            callback(std::move(batch));
+        });
+    }
 };
 
 struct async_file
@@ -32,4 +46,10 @@ struct async_dir
 //
 void calc_tree_size_async(const async_dir& root, function<void(int)> callback);
 
+//
+// Or this, with subtrees spread over the worker threads of a pool, when `async_dir` callbacks can run on any thread:
+//
+namespace l_async { class thread_pool_executor; }
+void calc_tree_size_parallel(const async_dir& root, l_async::thread_pool_executor& ex, function<void(int)> callback);
+
 #endif // _ASYNC_FS_SCAN_PROBLEM_H_
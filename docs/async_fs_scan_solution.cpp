@@ -1,30 +1,64 @@
 #include "async_fs_scan_problem.h"
 #include "l_async.h"
+#include "l_async_thread_pool.h"
 using l_async::loop;
 using l_async::result;
-using l_async::unique;
+using l_async::concurrent_result;
+using l_async::drain_batches;
+using l_async::spawn;
+using l_async::thread_pool_executor;
+
+const size_t batch_size = 256;
 
 void calc_tree_size_async(const async_dir& root, result<int> result)
 {
-    loop dirs([=, stream = unique(root.get_dirs())](auto next) mutable {
-        stream->next([&, next](auto dir) {
-            if (!dir) return;
-            calc_tree_size_async(*dir, result);
-            next();
+    drain_batches(
+        [stream = root.get_dirs()](auto callback) { stream->get_next_batch(batch_size, callback); },
+        [=](auto dirs) {
+            for (auto& dir : dirs)
+                calc_tree_size_async(*dir, result);
         });
-    });
-    loop files([=, stream = unique(root.get_files())](auto next) mutable {
-        stream->next([&, next](auto file) {
-            if (!file) return;
-            file->get_size([=](int size) mutable {
-                *result += size;
-            });
-            next();
+    drain_batches(
+        [stream = root.get_files()](auto callback) { stream->get_next_batch(batch_size, callback); },
+        [=](auto files) mutable {
+            for (auto& file : files) {
+                file->get_size([=](int size) mutable {
+                    *result += size;
+                });
+            }
         });
-    });
 }
 
 void calc_tree_size_async(const async_dir& root, function<void(int)> callback)
 {
     calc_tree_size_async(root, result<int>(callback));
 }
+
+// Each subdirectory is a separate pool task, so subtrees are stolen by idle workers,
+// and every task adds its files to its own copy of the `concurrent_result`.
+void calc_tree_size_parallel(const async_dir& root, thread_pool_executor& ex, concurrent_result<int> result)
+{
+    drain_batches(
+        [stream = root.get_dirs()](auto callback) { stream->get_next_batch(batch_size, callback); },
+        [&ex, result](auto dirs) {
+            for (auto& dir : dirs) {
+                spawn(ex, result, [&ex, dir = std::move(dir)](auto& result) {
+                    calc_tree_size_parallel(*dir, ex, result);
+                });
+            }
+        });
+    drain_batches(
+        [stream = root.get_files()](auto callback) { stream->get_next_batch(batch_size, callback); },
+        [=](auto files) mutable {
+            for (auto& file : files) {
+                file->get_size([=](int size) mutable {
+                    *result += size;
+                });
+            }
+        });
+}
+
+void calc_tree_size_parallel(const async_dir& root, thread_pool_executor& ex, function<void(int)> callback)
+{
+    calc_tree_size_parallel(root, ex, concurrent_result<int>(callback));
+}
@@ -0,0 +1,197 @@
+#ifndef _FAKE_FS_H_
+#define _FAKE_FS_H_
+
+#include <cstdint>
+#include <memory>
+using std::make_unique;
+
+#include <vector>
+using std::vector;
+
+#include "sync_fs_scan_problem.h"
+#include "async_fs_scan_problem.h"
+
+// Shape of a fake directory tree: by the depth of a dir, the number of its subdirectories, files and their size.
+struct fake_tree
+{
+    vector<int> dirs;
+    vector<int> files;
+    vector<int> file_sizes;
+    bool batched = true;  // fake async streams implement `get_next_batch`, otherwise they rely on the default one
+
+    // The tree of the tests, 81 in total: a dir has `3 - depth` subdirectories and `depth` files of size `depth`.
+    static fake_tree countdown()
+    {
+        return { { 3, 2, 1, 0 }, { 0, 1, 2, 3 }, { 0, 1, 2, 3 } };
+    }
+
+    // `fan_out` subdirectories in each dir above `depth`, `files_per_dir` files of size 1 in each dir.
+    static fake_tree uniform(int fan_out, int depth, int files_per_dir)
+    {
+        fake_tree tree;
+        for (int d = 0; d <= depth; d++) {
+            tree.dirs.push_back(d < depth ? fan_out : 0);
+            tree.files.push_back(files_per_dir);
+            tree.file_sizes.push_back(1);
+        }
+        return tree;
+    }
+
+    int dirs_at(int depth) const { return depth < int(dirs.size()) ? dirs[depth] : 0; }
+    int files_at(int depth) const { return depth < int(files.size()) ? files[depth] : 0; }
+    int file_size_at(int depth) const { return depth < int(file_sizes.size()) ? file_sizes[depth] : 0; }
+
+    // Dirs and files of the whole tree, the root included.
+    uint64_t nodes() const
+    {
+        uint64_t result = 0, level = 1;
+        for (size_t d = 0; d < dirs.size() && level; level *= uint64_t(dirs[d++]))
+            result += level * (1 + uint64_t(files_at(int(d))));
+        return result;
+    }
+
+    int64_t total_size() const
+    {
+        int64_t result = 0, level = 1;
+        for (size_t d = 0; d < dirs.size() && level; level *= dirs[d++])
+            result += level * files_at(int(d)) * file_size_at(int(d));
+        return result;
+    }
+};
+
+template<typename INTERFACE, typename IMPL>
+struct fake_sync_stream : sync_stream<INTERFACE>
+{
+    const fake_tree& tree;
+    int left, param;
+
+    fake_sync_stream(const fake_tree& tree, int left, int param)
+        : tree(tree)
+        , left(left)
+        , param(param)
+    {}
+
+    unique_ptr<INTERFACE> next() override
+    {
+        return left > 0
+            ? --left, make_unique<IMPL>(tree, param)
+            : unique_ptr<IMPL>();
+    }
+};
+
+struct fake_sync_file : sync_file
+{
+    int size;
+
+    fake_sync_file(const fake_tree&, int size)
+        : size(size)
+    {}
+
+    int get_size() const override
+    {
+        return size;
+    }
+};
+
+struct fake_sync_dir : sync_dir
+{
+    const fake_tree& tree;
+    int depth;
+
+    fake_sync_dir(const fake_tree& tree, int depth)
+        : tree(tree)
+        , depth(depth)
+    {}
+
+    unique_ptr<sync_stream<sync_file>> get_files() const override
+    {
+        return make_unique<fake_sync_stream<sync_file, fake_sync_file>>(tree, tree.files_at(depth), tree.file_size_at(depth));
+    }
+
+    unique_ptr<sync_stream<sync_dir>> get_dirs() const override
+    {
+        return make_unique<fake_sync_stream<sync_dir, fake_sync_dir>>(tree, tree.dirs_at(depth), depth + 1);
+    }
+};
+
+// Async fakes answer through tasks of `EX` (any executor with `schedule`).
+template<typename INTERFACE, typename IMPL, typename EX>
+struct fake_async_stream : async_stream<INTERFACE>
+{
+    const fake_tree& tree;
+    int left, param;
+    EX& ex;
+
+    fake_async_stream(const fake_tree& tree, int left, int param, EX& ex)
+        : tree(tree)
+        , left(left)
+        , param(param)
+        , ex(ex)
+    {}
+
+    void next(function<void(unique_ptr<INTERFACE>)> callback) override
+    {
+        ex.schedule([=, callback = move(callback)] {
+            callback(left > 0
+                ? --left, make_unique<IMPL>(tree, param, ex)
+                : unique_ptr<IMPL>());
+        });
+    }
+
+    void get_next_batch(size_t max, function<void(vector<unique_ptr<INTERFACE>>)> callback) override
+    {
+        if (!tree.batched)
+            return async_stream<INTERFACE>::get_next_batch(max, move(callback));
+        ex.schedule([=, callback = move(callback)] {
+            vector<unique_ptr<INTERFACE>> batch;
+            for (; left > 0 && batch.size() < max; --left)
+                batch.push_back(make_unique<IMPL>(tree, param, ex));
+            callback(move(batch));
+        });
+    }
+};
+
+template<typename EX>
+struct fake_async_file : async_file
+{
+    int size;
+    EX& ex;
+
+    fake_async_file(const fake_tree&, int size, EX& ex)
+        : size(size)
+        , ex(ex)
+    {}
+
+    void get_size(function<void(int)> callback) const override
+    {
+        ex.schedule([size = size, callback = move(callback)]{
+            callback(size);
+        });
+    }
+};
+
+template<typename EX>
+struct fake_async_dir : async_dir
+{
+    const fake_tree& tree;
+    int depth;
+    EX& ex;
+
+    fake_async_dir(const fake_tree& tree, int depth, EX& ex)
+        : tree(tree)
+        , depth(depth)
+        , ex(ex)
+    {}
+
+    unique_ptr<async_stream<async_file>> get_files() const override
+    {
+        return make_unique<fake_async_stream<async_file, fake_async_file<EX>, EX>>(tree, tree.files_at(depth), tree.file_size_at(depth), ex);
+    }
+
+    unique_ptr<async_stream<async_dir>> get_dirs() const override
+    {
+        return make_unique<fake_async_stream<async_dir, fake_async_dir<EX>, EX>>(tree, tree.dirs_at(depth), depth + 1, ex);
+    }
+};
+
+#endif // _FAKE_FS_H_
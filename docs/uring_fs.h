@@ -0,0 +1,447 @@
+#ifndef _URING_FS_H_
+#define _URING_FS_H_
+
+// Linux io_uring implementation of the `async_dir` API from async_fs_scan_problem.h.
+// `uring_executor` runs tasks like `single_thread_executor` and keeps an io_uring for file system requests:
+// requests made by one round of tasks are submitted with one `io_uring_enter`, their completions become tasks of the next round.
+// Directories are listed with `getdents64` in chunks (io_uring has no getdents operation), file sizes are requested with `statx` through the ring.
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define URING_FS_AVAILABLE 1
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "async_fs_scan_problem.h"
+#include "l_async.h"
+
+namespace uring_fs
+{
+    // Minimal io_uring wrapper working with raw syscalls (no liburing dependency).
+    class io_ring
+    {
+        int fd = -1;
+        unsigned* sq_head = nullptr;
+        unsigned* sq_tail = nullptr;
+        unsigned* sq_array = nullptr;
+        unsigned sq_mask = 0;
+        unsigned sq_entries = 0;
+        unsigned sqe_tail = 0;  // SQEs handed out by `get_sqe`, published to the kernel by `submit`.
+        io_uring_sqe* sqes = nullptr;
+        unsigned* cq_head = nullptr;
+        unsigned* cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        unsigned cq_entries = 0;
+        io_uring_cqe* cqes = nullptr;
+        void* sq_map = MAP_FAILED;
+        size_t sq_map_size = 0;
+        void* cq_map = MAP_FAILED;
+        size_t cq_map_size = 0;
+        void* sqe_map = MAP_FAILED;
+        size_t sqe_map_size = 0;
+
+        void release() noexcept
+        {
+            if (sqe_map != MAP_FAILED)
+                munmap(sqe_map, sqe_map_size);
+            if (cq_map != MAP_FAILED && cq_map != sq_map)
+                munmap(cq_map, cq_map_size);
+            if (sq_map != MAP_FAILED)
+                munmap(sq_map, sq_map_size);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        void* map(size_t size, off_t offset)
+        {
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            if (p == MAP_FAILED) {
+                int error = errno;
+                release();
+                throw std::system_error(error, std::system_category(), "io_uring mmap");
+            }
+            return p;
+        }
+
+    public:
+        explicit io_ring(unsigned entries)
+        {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            fd = int(syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0)
+                throw std::system_error(errno, std::system_category(), "io_uring_setup");
+            sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_map)
+                sq_map_size = cq_map_size = sq_map_size > cq_map_size ? sq_map_size : cq_map_size;
+            sq_map = map(sq_map_size, IORING_OFF_SQ_RING);
+            cq_map = single_map ? sq_map : map(cq_map_size, IORING_OFF_CQ_RING);
+            sqe_map_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqe_map = map(sqe_map_size, IORING_OFF_SQES);
+
+            auto sq = static_cast<char*>(sq_map);
+            sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_entries = params.sq_entries;
+            sqe_tail = *sq_tail;
+            sqes = static_cast<io_uring_sqe*>(sqe_map);
+
+            auto cq = static_cast<char*>(cq_map);
+            cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cq_entries = params.cq_entries;
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        }
+
+        io_ring(const io_ring&) = delete;
+        void operator= (const io_ring&) = delete;
+
+        ~io_ring()
+        {
+            release();
+        }
+
+        // Number of completions the ring can hold, callers should not keep more requests in flight.
+        unsigned capacity() const
+        {
+            return cq_entries;
+        }
+
+        // Returns a zeroed SQE or nullptr if the submission queue is full.
+        io_uring_sqe* get_sqe()
+        {
+            if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+                return nullptr;
+            unsigned index = sqe_tail++ & sq_mask;
+            sq_array[index] = index;
+            io_uring_sqe* sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        // Passes all filled SQEs to the kernel and waits for at least `wait_for` completions.
+        void submit(unsigned wait_for)
+        {
+            __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+            unsigned to_submit = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+            unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+            while (syscall(__NR_io_uring_enter, fd, to_submit, wait_for, flags, nullptr, 0) < 0) {
+                if (errno != EINTR)
+                    throw std::system_error(errno, std::system_category(), "io_uring_enter");
+                to_submit = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        // Calls `f(user_data, res)` for each available completion.
+        template<typename F>
+        void reap(F&& f)
+        {
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = cqes[head & cq_mask];
+                uint64_t user_data = cqe.user_data;
+                int res = cqe.res;
+                __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+                f(user_data, res);
+            }
+        }
+    };
+
+    /// <summary>
+    /// Single-threaded executor with an io_uring for file system requests.
+    /// Unlike `single_thread_executor` its `execute()` also waits for requests in flight.
+    /// </summary>
+    class uring_executor
+    {
+        struct statx_request
+        {
+            struct statx buffer;
+            std::string name;
+            l_async::unique_function<void(int, const struct statx&)> callback;
+        };
+
+        io_ring ring;
+        std::vector<l_async::unique_function<void()>> tasks;
+        unsigned in_flight = 0;
+
+        void reap()
+        {
+            ring.reap([&](uint64_t user_data, int res) {
+                in_flight--;
+                std::unique_ptr<statx_request> request(reinterpret_cast<statx_request*>(user_data));
+                tasks.emplace_back([request = std::move(request), res] {
+                    request->callback(res, request->buffer);
+                });
+            });
+        }
+
+        io_uring_sqe* get_sqe()
+        {
+            while (in_flight >= ring.capacity()) {
+                ring.submit(1);
+                reap();
+            }
+            io_uring_sqe* sqe = ring.get_sqe();
+            if (!sqe) {
+                ring.submit(0);
+                sqe = ring.get_sqe();
+            }
+            assert(sqe);
+            return sqe;
+        }
+
+    public:
+        explicit uring_executor(unsigned ring_entries = 256)
+            : ring(ring_entries)
+        {}
+
+        ~uring_executor()
+        {
+            // Requests own buffers that the kernel writes to, so they are completed before the ring is closed.
+            while (in_flight) {
+                ring.submit(1);
+                reap();
+            }
+        }
+
+        /// <summary>
+        /// Schedules a task for later execution.
+        /// </summary>
+        void schedule(l_async::unique_function<void()> task)
+        {
+            tasks.emplace_back(std::move(task));
+        }
+
+        /// <summary>
+        /// Requests `statx` of `name` relative to `dirfd` (without following symlinks).
+        /// `callback(res, buffer)` is called as a task of this executor, `res` is 0 or `-errno`.
+        /// `dirfd` must stay open till the request is completed.
+        /// </summary>
+        void statx(int dirfd, std::string name, unsigned mask, l_async::unique_function<void(int, const struct statx&)> callback)
+        {
+            auto request = new statx_request{ {}, std::move(name), std::move(callback) };
+            io_uring_sqe* sqe = get_sqe();
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dirfd;
+            sqe->addr = reinterpret_cast<uint64_t>(request->name.c_str());
+            sqe->len = mask;
+            sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+            sqe->off = reinterpret_cast<uint64_t>(&request->buffer);
+            sqe->user_data = reinterpret_cast<uint64_t>(request);
+            in_flight++;
+        }
+
+        /// <summary>
+        /// Executes tasks and waits for I/O until there are neither tasks nor requests in flight.
+        /// Requests issued by one round of tasks are submitted together.
+        /// </summary>
+        void execute()
+        {
+            for (;;) {
+                while (!tasks.empty()) {
+                    std::vector<l_async::unique_function<void()>> current_tasks;
+                    std::swap(current_tasks, tasks);
+                    for (auto& t : current_tasks)
+                        t();
+                }
+                if (!in_flight)
+                    break;
+                ring.submit(1);
+                reap();
+            }
+        }
+    };
+
+    // Directory descriptor shared by streams and files that refer to it.
+    struct dir_handle
+    {
+        int fd;
+
+        explicit dir_handle(int fd)
+            : fd(fd)
+        {}
+
+        dir_handle(const dir_handle&) = delete;
+        void operator= (const dir_handle&) = delete;
+
+        ~dir_handle()
+        {
+            close(fd);
+        }
+    };
+
+    class uring_file : public async_file
+    {
+        uring_executor& ex;
+        std::shared_ptr<dir_handle> dir;
+        std::string name;
+
+    public:
+        uring_file(uring_executor& ex, std::shared_ptr<dir_handle> dir, std::string name)
+            : ex(ex)
+            , dir(std::move(dir))
+            , name(std::move(name))
+        {}
+
+        // Sizes that don't fit `int` are truncated by the interface, unavailable files have size 0.
+        void get_size(function<void(int)> callback) const override
+        {
+            ex.statx(dir->fd, name, STATX_SIZE, [dir = dir, callback = std::move(callback)](int res, const struct statx& st) {
+                callback(res < 0 ? 0 : int(st.stx_size));
+            });
+        }
+    };
+
+    // Lists entries of one type (`DT_REG` or `DT_DIR`) of a directory with `getdents64`, symlinks are not followed.
+    template<typename INTERFACE, typename IMPL, unsigned char TYPE>
+    class uring_stream : public async_stream<INTERFACE>
+    {
+        struct linux_dirent64
+        {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[1];
+        };
+
+        static constexpr size_t chunk_size = 32 * 1024;
+
+        uring_executor& ex;
+        std::shared_ptr<dir_handle> parent;
+        std::string path;
+        std::shared_ptr<dir_handle> dir;
+        vector<unique_ptr<INTERFACE>> buffered;
+        bool ended = false;
+
+        bool open()
+        {
+            int fd = openat(parent ? parent->fd : AT_FDCWD, path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            dir = std::make_shared<dir_handle>(fd);
+            return true;
+        }
+
+        bool matches(const linux_dirent64& entry) const
+        {
+            const char* name = entry.d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+                return false;
+            if (entry.d_type != DT_UNKNOWN)
+                return entry.d_type == TYPE;
+            struct stat st;
+            if (fstatat(dir->fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+                return false;
+            return TYPE == DT_DIR ? S_ISDIR(st.st_mode) : S_ISREG(st.st_mode);
+        }
+
+        // Reads one chunk of entries into `buffered`.
+        void read_chunk()
+        {
+            if (!dir && !open()) {
+                ended = true;
+                return;
+            }
+            alignas(linux_dirent64) char chunk[chunk_size];
+            long n = syscall(SYS_getdents64, dir->fd, chunk, chunk_size);
+            if (n <= 0) {
+                ended = true;
+                dir.reset();  // Files keep the descriptor while their sizes are requested.
+                return;
+            }
+            for (long offset = 0; offset < n;) {
+                auto& entry = *reinterpret_cast<linux_dirent64*>(chunk + offset);
+                if (matches(entry))
+                    buffered.push_back(std::make_unique<IMPL>(ex, dir, std::string(entry.d_name)));
+                offset += entry.d_reclen;
+            }
+        }
+
+        vector<unique_ptr<INTERFACE>> take(size_t max)
+        {
+            while (buffered.empty() && !ended)
+                read_chunk();
+            if (buffered.size() <= max)
+                return std::move(buffered);
+            vector<unique_ptr<INTERFACE>> batch(
+                std::make_move_iterator(buffered.end() - max),
+                std::make_move_iterator(buffered.end()));
+            buffered.resize(buffered.size() - max);
+            return batch;
+        }
+
+    public:
+        uring_stream(uring_executor& ex, std::shared_ptr<dir_handle> parent, std::string path)
+            : ex(ex)
+            , parent(std::move(parent))
+            , path(std::move(path))
+        {}
+
+        void next(function<void(unique_ptr<INTERFACE>)> callback) override
+        {
+            get_next_batch(1, [callback = std::move(callback)](vector<unique_ptr<INTERFACE>> batch) {
+                callback(batch.empty() ? nullptr : std::move(batch[0]));
+            });
+        }
+
+        void get_next_batch(size_t max, function<void(vector<unique_ptr<INTERFACE>>)> callback) override
+        {
+            ex.schedule([this, max, callback = std::move(callback)] {
+                callback(take(max));
+            });
+        }
+    };
+
+    class uring_dir : public async_dir
+    {
+        uring_executor& ex;
+        std::shared_ptr<dir_handle> parent;
+        std::string path;
+
+    public:
+        // Directory at `path`, relative to the current one.
+        uring_dir(uring_executor& ex, std::string path)
+            : uring_dir(ex, nullptr, std::move(path))
+        {}
+
+        // Directory at `path`, relative to the `parent` one.
+        uring_dir(uring_executor& ex, std::shared_ptr<dir_handle> parent, std::string path)
+            : ex(ex)
+            , parent(std::move(parent))
+            , path(std::move(path))
+        {}
+
+        unique_ptr<async_stream<async_file>> get_files() const override
+        {
+            return std::make_unique<uring_stream<async_file, uring_file, DT_REG>>(ex, parent, path);
+        }
+
+        unique_ptr<async_stream<async_dir>> get_dirs() const override
+        {
+            return std::make_unique<uring_stream<async_dir, uring_dir, DT_DIR>>(ex, parent, path);
+        }
+    };
+}
+
+#endif  // __linux__
+
+#endif  // _URING_FS_H_
@@ -0,0 +1,85 @@
+#include "uring_fs.h"
+
+#if defined(URING_FS_AVAILABLE)
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+namespace fs = std::filesystem;
+
+#include "gunit.h"
+using uring_fs::uring_executor;
+using uring_fs::uring_dir;
+
+namespace
+{
+    struct temp_tree
+    {
+        fs::path root;
+        int total = 0;
+
+        temp_tree()
+        {
+            std::string pattern = (fs::temp_directory_path() / "l_async_uring_XXXXXX").string();
+            root = mkdtemp(&pattern[0]);
+        }
+
+        ~temp_tree()
+        {
+            fs::remove_all(root);
+        }
+
+        void add_file(const fs::path& path, int size)
+        {
+            std::ofstream(root / path, std::ios::binary) << std::string(size_t(size), 'x');
+            total += size;
+        }
+
+        void add_dir(const fs::path& path)
+        {
+            fs::create_directories(root / path);
+        }
+    };
+
+    void fill(temp_tree& tree, const fs::path& dir, int depth)
+    {
+        tree.add_dir(dir);
+        for (int i = 0; i < depth; i++)
+            tree.add_file(dir / ("f" + std::to_string(i)), depth * 10 + i);
+        if (depth < 3) {
+            for (int i = 0; i < 3; i++)
+                fill(tree, dir / ("d" + std::to_string(i)), depth + 1);
+        }
+    }
+
+    TEST(LAsync, UringFileSystemTest)
+    {
+        temp_tree tree;
+        fill(tree, "scan", 0);
+        tree.add_dir("scan/wide");
+        for (int i = 0; i < 1000; i++)  // more than the ring and one getdents chunk hold
+            tree.add_file("scan/wide/file_with_a_long_name_" + std::to_string(i), i % 7);
+        fs::create_directory_symlink(tree.root / "scan/d0", tree.root / "scan/link");  // not followed
+
+        uring_executor ex(64);
+        int total = -1;
+        calc_tree_size_async(uring_dir(ex, (tree.root / "scan").string()), [&](int size) {
+            total = size;
+        });
+        ex.execute();
+        ASSERT_EQ(total, tree.total);
+    }
+
+    TEST(LAsync, UringMissingDirTest)
+    {
+        uring_executor ex;
+        int total = -1;
+        calc_tree_size_async(uring_dir(ex, "/nonexistent/l_async"), [&](int size) {
+            total = size;
+        });
+        ex.execute();
+        ASSERT_EQ(total, 0);
+    }
+}
+
+#endif  // URING_FS_AVAILABLE
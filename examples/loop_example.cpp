@@ -102,8 +102,9 @@ void accumulate(
 /// all its actions in constructor. In line [1] we
 /// create a local variable of its type.
 /// 
-/// Instance of `l_async::loop` is a shared pointer
-/// to the context data incapsulated in std::function.
+/// Instance of `l_async::loop` is an intrusive pointer
+/// to the heap block holding the lambda with its context
+/// data, the reference counter and the restart flag.
 /// In line [2] we move our parameters in that context,
 /// in line [3] we store there our result.
 /// 
@@ -23,7 +23,6 @@ using executor = testing::single_thread_executor;
 #include "l_async.h"
 using l_async::loop;
 using l_async::slot;
-using l_async::result;
 
 // Let's make `std::pair` and `std::optional` printable
 namespace std
@@ -55,9 +54,9 @@ namespace
     // will return the infinite sequence of `nullopt`s.
     // 
     // So a consumer asks a provider for another stream item and passes
-    // callback, that expects `optional<T>`:
+    // callback, that expects `optional<T>` (it is move-only, so it can hold `join` setters):
     template<typename T>
-    using stream_callback = function<void(optional<T>)>;
+    using stream_callback = l_async::unique_function<void(optional<T>)>;
 
     // The provider function takes callback as parameter:
     template<typename T>
@@ -102,14 +101,14 @@ namespace
             sink = stream.get_provider()
         ](auto next) mutable {
             sink.await([&, next] {
-                result<pair<optional<A>, optional<B>>> expected([&, next](auto r){
-                    sink(r.first && r.second
-                        ? optional(pair{move(*r.first), move(*r.second)})
+                l_async::join<optional<A>, optional<B>> expected([&, next](optional<A> ra, optional<B> rb) {
+                    sink(ra && rb
+                        ? optional(pair{move(*ra), move(*rb)})
                         : nullopt);
                     next();
                 });
-                a(expected.setter(expected->first));  // these requests...
-                b(expected.setter(expected->second)); // ...performed in parallel
+                a(expected.template get<0>());  // these requests...
+                b(expected.template get<1>());  // ...performed in parallel
             });
         });
         return stream;
@@ -3,78 +3,1549 @@
 
 #include <memory>
 #include <functional>
+#include <atomic>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <optional>
+#include <tuple>
 #include <cassert>
+#include <exception>
+
+#if defined(L_ASYNC_TRACING)
+#include "l_async_trace.h"
+#if !defined(L_ASYNC_TRACER)
+#define L_ASYNC_TRACER ::l_async::trace::recorder
+#endif
+#endif
 
 namespace l_async
 {
-    class loop
+    // Tracing hooks called by primitives, see l_async_trace.h.
+    struct null_tracer
+    {
+        static void loop_created(const void*) noexcept {}
+        static void loop_iteration(const void*, bool /*sync_restart*/) noexcept {}
+        static void loop_destroyed(const void*) noexcept {}
+        static void result_fired(const void*) noexcept {}
+        static void slot_awaited(const void*) noexcept {}
+        static void slot_delivered(const void*) noexcept {}
+        static void context_allocated(const void*, size_t /*bytes*/) noexcept {}
+        static void context_freed(const void*, size_t /*bytes*/) noexcept {}
+    };
+
+#if defined(L_ASYNC_TRACER)
+    using tracer = L_ASYNC_TRACER;
+#else
+    using tracer = null_tracer;
+#endif
+
+    // Reference counting and restart flag policy for primitives that can be shared across threads.
+    struct multi_threaded
+    {
+        class counter
+        {
+            std::atomic<unsigned> n{ 1 };
+
+        public:
+            void add_ref() noexcept { n.fetch_add(1, std::memory_order_relaxed); }
+            bool release() noexcept { return n.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+            // Adds a reference unless the count has dropped to zero.
+            bool try_add_ref() noexcept
+            {
+                unsigned c = n.load(std::memory_order_relaxed);
+                while (c && !n.compare_exchange_weak(c, c + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {}
+                return c != 0;
+            }
+        };
+
+        class flag
+        {
+            std::atomic<unsigned char> v{ 0 };
+
+        public:
+            // Inverts the flag, returns its new value.
+            bool toggle() noexcept { return v.fetch_xor(1, std::memory_order_acq_rel) == 0; }
+        };
+    };
+
+    // Non-atomic policy for primitives that never leave their thread (e.g. single_thread_executor).
+    struct single_threaded
+    {
+        class counter
+        {
+            unsigned n = 1;
+
+        public:
+            void add_ref() noexcept { ++n; }
+            bool release() noexcept { return --n == 0; }
+            bool try_add_ref() noexcept { return n && ++n; }
+        };
+
+        class flag
+        {
+            bool v = false;
+
+        public:
+            bool toggle() noexcept { return (v = !v); }
+        };
+    };
+
+    // Policy of `loop`, `result` and `slot` unless given explicitly.
+    // Defining `L_ASYNC_SINGLE_THREADED` for all translation units of a program, where these primitives never cross threads,
+    // switches them to non-atomic reference counts. `join`, `concurrent_result` and `thread_pool_executor` stay thread-safe.
+#ifdef L_ASYNC_SINGLE_THREADED
+    using default_policy = single_threaded;
+#else
+    using default_policy = multi_threaded;
+#endif
+
+    namespace detail
+    {
+        template<typename Block, typename = void>
+        struct has_destroy : std::false_type {};
+
+        template<typename Block>
+        struct has_destroy<Block, std::void_t<decltype(std::declval<Block&>().destroy())>> : std::true_type {};
+
+        // Runs `fn` inline unless `depth` of nested inline runs has reached `max_depth`, used by executors' `dispatch`.
+        template<typename F>
+        bool run_inline(size_t& depth, size_t max_depth, F& fn)
+        {
+            if (depth >= max_depth)
+                return false;
+            struct guard
+            {
+                size_t& depth;
+                ~guard() { depth--; }
+            } g{ ++depth };
+            fn();
+            return true;
+        }
+
+        // Block of the innermost loop, whose body runs on this thread.
+        inline const void*& running_loop() noexcept
+        {
+            static thread_local const void* block = nullptr;
+            return block;
+        }
+
+        // Runs iterations of a loop `block` with `restart` flag and plain `sync_restart` flag, `iterate(sync_restart)` runs the body once.
+        // With thread-safe policies `next()` called by the running body only sets `sync_restart`, so synchronous restarts skip
+        // the atomic `restart` toggles, that hand iterations over between threads.
+        template<typename Block, typename Iterate>
+        void run_loop(Block* block, Iterate&& iterate)
+        {
+            if constexpr (std::is_same_v<decltype(block->restart), single_threaded::flag>) {
+                for (bool sync_restart = false; block->restart.toggle(); sync_restart = true)
+                    iterate(sync_restart);
+            } else {
+                const void*& running = running_loop();
+                if (running == block) {
+                    block->sync_restart = true;
+                    return;
+                }
+                struct guard
+                {
+                    const void*& running;
+                    const void* outer;
+                    ~guard() { running = outer; }
+                } g{ running, std::exchange(running, block) };
+                for (bool sync_restart = false; block->restart.toggle(); sync_restart = true) {
+                    do {
+                        block->sync_restart = false;
+                        iterate(sync_restart);
+                        sync_restart = true;
+                    } while (block->sync_restart);
+                }
+            }
+        }
+
+        // Slot block, whose request listener the consumer runs inline on this thread, holding a strong reference down the stack.
+        inline const void*& sync_request_slot() noexcept
+        {
+            static thread_local const void* block = nullptr;
+            return block;
+        }
+
+        // Base of control blocks (contexts) of primitives: their heap memory is reported to the tracer.
+        // Sized `delete` gets the size of the most derived block, as blocks with derived types have virtual destructors.
+        struct context_block
+        {
+            static void* operator new(size_t bytes)
+            {
+                void* p = ::operator new(bytes);
+                tracer::context_allocated(p, bytes);
+                return p;
+            }
+
+            static void* operator new(size_t bytes, std::align_val_t align)
+            {
+                void* p = ::operator new(bytes, align);
+                tracer::context_allocated(p, bytes);
+                return p;
+            }
+
+            static void operator delete(void* p, size_t bytes) noexcept
+            {
+                tracer::context_freed(p, bytes);
+                ::operator delete(p);
+            }
+
+            static void operator delete(void* p, size_t bytes, std::align_val_t align) noexcept
+            {
+                tracer::context_freed(p, bytes);
+                ::operator delete(p, align);
+            }
+        };
+
+        // Blocks from an allocator are reported to the tracer as well.
+        template<typename T, typename Alloc, typename... Args>
+        T* allocate_block(const Alloc& alloc, Args&&... args)
+        {
+            using traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+            typename traits::allocator_type a(alloc);
+            T* p = traits::allocate(a, 1);
+            try {
+                traits::construct(a, p, std::forward<Args>(args)...);
+            } catch (...) {
+                traits::deallocate(a, p, 1);
+                throw;
+            }
+            tracer::context_allocated(p, sizeof(T));
+            return p;
+        }
+
+        template<typename T, typename Alloc>
+        void deallocate_block(Alloc alloc, T* p)
+        {
+            using traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+            typename traits::allocator_type a(alloc);
+            tracer::context_freed(p, sizeof(T));
+            traits::destroy(a, p);
+            traits::deallocate(a, p, 1);
+        }
+
+        // Intrusive pointer to a heap block having `refs` counter, a block is created with one reference.
+        template<typename Block>
+        class ref_ptr
+        {
+            Block* ptr = nullptr;
+
+        public:
+            ref_ptr() = default;
+
+            explicit ref_ptr(Block* ptr) noexcept
+                : ptr(ptr)
+            {}
+
+            ref_ptr(const ref_ptr& src) noexcept
+                : ptr(src.ptr)
+            {
+                if (ptr)
+                    ptr->refs.add_ref();
+            }
+
+            ref_ptr(ref_ptr&& src) noexcept
+                : ptr(src.ptr)
+            {
+                src.ptr = nullptr;
+            }
+
+            ref_ptr& operator= (ref_ptr src) noexcept
+            {
+                std::swap(ptr, src.ptr);
+                return *this;
+            }
+
+            ~ref_ptr()
+            {
+                if (ptr && ptr->refs.release()) {
+                    if constexpr (has_destroy<Block>::value)
+                        ptr->destroy();
+                    else
+                        delete ptr;
+                }
+            }
+
+            Block& operator* () const noexcept { return *ptr; }
+            Block* operator-> () const noexcept { return ptr; }
+            Block* get() const noexcept { return ptr; }
+            explicit operator bool() const noexcept { return ptr != nullptr; }
+        };
+
+        // Weak pointer to a `ref_ptr` block, that also has `weak_refs` counter (with one reference held by all strong ones)
+        // and `release_weak()` freeing the block memory when it drops to zero.
+        template<typename Block>
+        class weak_ref_ptr
+        {
+            Block* ptr = nullptr;
+
+        public:
+            weak_ref_ptr() = default;
+
+            explicit weak_ref_ptr(const ref_ptr<Block>& src) noexcept
+                : ptr(src.get())
+            {
+                if (ptr)
+                    ptr->weak_refs.add_ref();
+            }
+
+            weak_ref_ptr(const weak_ref_ptr& src) noexcept
+                : ptr(src.ptr)
+            {
+                if (ptr)
+                    ptr->weak_refs.add_ref();
+            }
+
+            weak_ref_ptr(weak_ref_ptr&& src) noexcept
+                : ptr(src.ptr)
+            {
+                src.ptr = nullptr;
+            }
+
+            weak_ref_ptr& operator= (weak_ref_ptr src) noexcept
+            {
+                std::swap(ptr, src.ptr);
+                return *this;
+            }
+
+            ~weak_ref_ptr()
+            {
+                if (ptr)
+                    ptr->release_weak();
+            }
+
+            // The block, which may be already released by strong references.
+            Block* get() const noexcept { return ptr; }
+
+            // Strong pointer if the block is still referenced, null otherwise.
+            ref_ptr<Block> lock() const noexcept
+            {
+                return ptr && ptr->refs.try_add_ref() ? ref_ptr<Block>(ptr) : ref_ptr<Block>();
+            }
+        };
+    }
+
+    template<typename Signature, size_t Capacity = 4 * sizeof(void*)>
+    class unique_function;
+
+    // Move-only replacement of `std::function`.
+    // Callables that fit `Capacity` bytes and are nothrow-movable are stored inline, others on heap.
+    template<typename R, typename... Args, size_t Capacity>
+    class unique_function<R(Args...), Capacity>
+    {
+        struct vtable
+        {
+            R (*invoke)(void* storage, Args&&... args);
+            void (*relocate)(void* dst, void* src) noexcept;
+            void (*destroy)(void* storage) noexcept;
+        };
+
+        template<typename F>
+        static constexpr bool is_inline =
+            sizeof(F) <= Capacity &&
+            alignof(F) <= alignof(void*) &&
+            std::is_nothrow_move_constructible_v<F>;
+
+        template<typename F>
+        static F& target(void* storage) noexcept
+        {
+            if constexpr (is_inline<F>)
+                return *static_cast<F*>(storage);
+            else
+                return **static_cast<F**>(storage);
+        }
+
+        template<typename F>
+        static constexpr vtable vtable_for{
+            [](void* storage, Args&&... args) -> R {
+                return target<F>(storage)(std::forward<Args>(args)...);
+            },
+            [](void* dst, void* src) noexcept {
+                if constexpr (is_inline<F>) {
+                    new (dst) F(std::move(target<F>(src)));
+                    target<F>(src).~F();
+                } else {
+                    *static_cast<F**>(dst) = *static_cast<F**>(src);
+                }
+            },
+            [](void* storage) noexcept {
+                if constexpr (is_inline<F>)
+                    target<F>(storage).~F();
+                else
+                    delete &target<F>(storage);
+            }
+        };
+
+        template<typename F>
+        static bool is_null(const F& f) noexcept
+        {
+            if constexpr (std::is_pointer_v<F> || std::is_member_pointer_v<F>)
+                return f == nullptr;
+            else if constexpr (std::is_same_v<F, std::function<R(Args...)>>)
+                return !f;
+            else
+                return false;
+        }
+
+        alignas(void*) mutable unsigned char storage[Capacity];
+        const vtable* vt = nullptr;
+
+    public:
+        unique_function() noexcept = default;
+
+        unique_function(std::nullptr_t) noexcept
+        {}
+
+        template<typename F, typename D = std::decay_t<F>, typename = std::enable_if_t<
+            !std::is_same_v<D, unique_function> &&
+            std::is_invocable_r_v<R, D&, Args...>>>
+        unique_function(F&& f)
+        {
+            if (is_null(f))
+                return;
+            if constexpr (is_inline<D>)
+                new (storage) D(std::forward<F>(f));
+            else
+                *reinterpret_cast<D**>(storage) = new D(std::forward<F>(f));
+            vt = &vtable_for<D>;
+        }
+
+        unique_function(unique_function&& src) noexcept
+            : vt(src.vt)
+        {
+            if (vt) {
+                vt->relocate(storage, src.storage);
+                src.vt = nullptr;
+            }
+        }
+
+        unique_function& operator= (unique_function&& src) noexcept
+        {
+            if (this != &src) {
+                reset();
+                if ((vt = src.vt)) {
+                    vt->relocate(storage, src.storage);
+                    src.vt = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        unique_function& operator= (std::nullptr_t) noexcept
+        {
+            reset();
+            return *this;
+        }
+
+        unique_function(const unique_function&) = delete;
+        unique_function& operator= (const unique_function&) = delete;
+
+        ~unique_function()
+        {
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            if (vt) {
+                vt->destroy(storage);
+                vt = nullptr;
+            }
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return vt != nullptr;
+        }
+
+        R operator() (Args... args) const
+        {
+            assert(vt);
+            return vt->invoke(storage, std::forward<Args>(args)...);
+        }
+
+        friend void swap(unique_function& a, unique_function& b) noexcept
+        {
+            unique_function t(std::move(a));
+            a = std::move(b);
+            b = std::move(t);
+        }
+    };
+
+    class cancellation_token;
+    class cancellation_subscription;
+
+    namespace detail
+    {
+        struct cancellation_state
+        {
+            multi_threaded::counter refs;
+            std::atomic<bool> cancelled{ false };
+            std::recursive_mutex mutex;  // Callbacks can destroy other subscriptions.
+            cancellation_subscription* head = nullptr;
+        };
+    }
+
+    /// <summary>
+    /// Observer of a `cancellation_source`.
+    /// A default-constructed token is never cancelled.
+    /// </summary>
+    class cancellation_token
+    {
+        friend class cancellation_source;
+        friend class cancellation_subscription;
+
+        detail::ref_ptr<detail::cancellation_state> state;
+
+        explicit cancellation_token(detail::ref_ptr<detail::cancellation_state> state)
+            : state(std::move(state))
+        {}
+
+    public:
+        cancellation_token() = default;
+
+        bool is_cancelled() const noexcept
+        {
+            return state && state->cancelled.load(std::memory_order_acquire);
+        }
+    };
+
+    /// <summary>
+    /// Calls `callback` once on the thread that cancels the token (or immediately, if it is already cancelled).
+    /// Destruction unsubscribes the callback, if the token is being cancelled on another thread, it waits till cancellation ends.
+    /// </summary>
+    class cancellation_subscription
+    {
+        friend class cancellation_source;
+
+        detail::ref_ptr<detail::cancellation_state> state;
+        cancellation_subscription* prev = nullptr;
+        cancellation_subscription* next = nullptr;
+        bool linked = false;
+        unique_function<void()> callback;
+
+        void unlink() noexcept
+        {
+            (prev ? prev->next : state->head) = next;
+            if (next)
+                next->prev = prev;
+            linked = false;
+        }
+
+    public:
+        cancellation_subscription(const cancellation_token& token, unique_function<void()> callback)
+            : state(token.state)
+            , callback(std::move(callback))
+        {
+            if (!state)
+                return;
+            {
+                std::lock_guard<std::recursive_mutex> lock(state->mutex);
+                if (!state->cancelled.load(std::memory_order_relaxed)) {
+                    next = state->head;
+                    if (next)
+                        next->prev = this;
+                    state->head = this;
+                    linked = true;
+                    return;
+                }
+            }
+            unique_function<void()> temp(std::move(this->callback));
+            temp();
+        }
+
+        cancellation_subscription(const cancellation_subscription&) = delete;
+        void operator= (const cancellation_subscription&) = delete;
+
+        ~cancellation_subscription()
+        {
+            if (state) {
+                std::lock_guard<std::recursive_mutex> lock(state->mutex);
+                if (linked)
+                    unlink();
+            }
+        }
+    };
+
+    /// <summary>
+    /// Requests cancellation of the operations, that observe its tokens.
+    /// `loop`s check the token before each iteration, so they can be cancelled from any thread.
+    /// `slot`s and `result`s drop their listeners in subscriptions called by `cancel()`,
+    /// so they must be cancelled on the thread (executor) that runs them.
+    /// </summary>
+    class cancellation_source
+    {
+        detail::ref_ptr<detail::cancellation_state> state;
+
+    public:
+        cancellation_source()
+            : state(new detail::cancellation_state)
+        {}
+
+        cancellation_token get_token() const
+        {
+            return cancellation_token(state);
+        }
+
+        bool is_cancelled() const noexcept
+        {
+            return state->cancelled.load(std::memory_order_acquire);
+        }
+
+        // Marks tokens as cancelled and calls all subscriptions, subsequent calls do nothing.
+        void cancel()
+        {
+            std::lock_guard<std::recursive_mutex> lock(state->mutex);
+            if (state->cancelled.exchange(true, std::memory_order_acq_rel))
+                return;
+            while (auto s = state->head) {
+                s->unlink();
+                unique_function<void()> temp(std::move(s->callback));
+                temp();  // May destroy `s`.
+            }
+        }
+    };
+
+    // Loop with a statically known body, its lambda and restart flag share one heap block.
+    // `Body = void` selects the type-erased `loop`.
+    template<typename Body = void, typename Policy = default_policy>
+    class basic_loop
+    {
+        struct block : detail::context_block
+        {
+            typename Policy::counter refs;
+            typename Policy::flag restart;
+            bool sync_restart = false;
+            Body body;
+
+            block(Body&& body)
+                : body(std::move(body))
+            {
+                tracer::loop_created(this);
+            }
+
+            ~block()
+            {
+                tracer::loop_destroyed(this);
+            }
+        };
+
+        detail::ref_ptr<block> ptr;
+
+    public:
+        explicit basic_loop(Body body)
+            : ptr(new block(std::move(body)))
+        {
+            operator()();
+        }
+
+        void operator() () const
+        {
+            detail::run_loop(ptr.get(), [this](bool sync_restart) {
+                tracer::loop_iteration(ptr.get(), sync_restart);
+                ptr->body(*this);
+            });
+        }
+    };
+
+    template<typename Policy>
+    class basic_loop<void, Policy>
+    {
+        struct block : detail::context_block
+        {
+            typename Policy::counter refs;
+            typename Policy::flag restart;
+            bool sync_restart = false;
+
+            block()
+            {
+                tracer::loop_created(this);
+            }
+
+            virtual ~block()
+            {
+                tracer::loop_destroyed(this);
+            }
+
+            virtual void run(const basic_loop& next) = 0;
+            virtual void destroy() = 0;
+        };
+
+        template<typename F>
+        struct body_block : block
+        {
+            F body;
+
+            body_block(F&& body)
+                : body(std::move(body))
+            {}
+
+            void run(const basic_loop& next) override
+            {
+                body(next);
+            }
+
+            void destroy() override
+            {
+                delete this;
+            }
+        };
+
+        template<typename F, typename Alloc>
+        struct allocated_block final : body_block<F>
+        {
+            Alloc alloc;
+
+            allocated_block(F&& body, const Alloc& alloc)
+                : body_block<F>(std::move(body))
+                , alloc(alloc)
+            {}
+
+            void destroy() override
+            {
+                detail::deallocate_block(alloc, this);
+            }
+        };
+
+        // Drops the body (and with it all its captures) at the first iteration after cancellation.
+        template<typename F>
+        struct cancellable_block final : block
+        {
+            std::optional<F> body;
+            cancellation_token token;
+
+            cancellable_block(F&& body, cancellation_token token)
+                : body(std::move(body))
+                , token(std::move(token))
+            {}
+
+            void run(const basic_loop& next) override
+            {
+                if (token.is_cancelled())
+                    body.reset();
+                else if (body)
+                    (*body)(next);
+            }
+
+            void destroy() override
+            {
+                delete this;
+            }
+        };
+
+        detail::ref_ptr<block> ptr;
+
+    public:
+        template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, basic_loop>>>
+        basic_loop(F body)
+            : ptr(new body_block<F>(std::move(body)))
+        {
+            operator()();
+        }
+
+        // Loop that stops and releases its body when the `token` is cancelled,
+        // pending `next` calls become no-ops.
+        template<typename F>
+        basic_loop(cancellation_token token, F body)
+            : ptr(new cancellable_block<F>(std::move(body), std::move(token)))
+        {
+            operator()();
+        }
+
+        // Allocates the loop block with the given allocator.
+        template<typename Alloc, typename F>
+        basic_loop(std::allocator_arg_t, const Alloc& alloc, F body)
+            : ptr(detail::allocate_block<allocated_block<F, Alloc>>(alloc, std::move(body), alloc))
+        {
+            operator()();
+        }
+
+        void operator() () const
+        {
+            detail::run_loop(ptr.get(), [this](bool sync_restart) {
+                tracer::loop_iteration(ptr.get(), sync_restart);
+                ptr->run(*this);
+            });
+        }
+    };
+
+    template<typename Body>
+    basic_loop(Body) -> basic_loop<Body>;
+
+    using loop = basic_loop<>;
+    using local_loop = basic_loop<void, single_threaded>;
+
+    template<typename T, typename Policy = default_policy>
+    class result
+    {
+        struct data_t : detail::context_block
+        {
+            typename Policy::counter refs;
+            T data;
+            unique_function<void(T)> callback;
+
+            data_t(T data, unique_function<void(T)> callback)
+                : data(std::move(data))
+                , callback(std::move(callback))
+            {}
+
+            virtual ~data_t()
+            {
+                tracer::result_fired(this);
+                if (callback)
+                    callback(std::move(data));
+            }
+
+            virtual void destroy()
+            {
+                delete this;
+            }
+        };
+
+        template<typename Alloc>
+        struct allocated_data_t final : data_t
+        {
+            Alloc alloc;
+
+            allocated_data_t(T data, unique_function<void(T)> callback, const Alloc& alloc)
+                : data_t(std::move(data), std::move(callback))
+                , alloc(alloc)
+            {}
+
+            void destroy() override
+            {
+                detail::deallocate_block(alloc, this);
+            }
+        };
+
+        struct cancellable_data_t : data_t
+        {
+            cancellation_subscription subscription;
+
+            cancellable_data_t(T data, unique_function<void(T)> callback, const cancellation_token& token)
+                : data_t(std::move(data), std::move(callback))
+                , subscription(token, [this] {
+                    unique_function<void(T)> temp(std::move(this->callback));
+                })
+            {}
+        };
+
+        detail::ref_ptr<data_t> ptr;
+
+    public:
+        result(unique_function<void(T)> callback, T initial_value = T())
+            : ptr(new data_t(
+                std::move(initial_value),
+                std::move(callback)))
+        {}
+
+        // Result, whose callback is released without a call when the `token` is cancelled.
+        result(cancellation_token token, unique_function<void(T)> callback, T initial_value = T())
+            : ptr(new cancellable_data_t(
+                std::move(initial_value),
+                std::move(callback),
+                token))
+        {}
+
+        template<typename Alloc>
+        result(std::allocator_arg_t, const Alloc& alloc, unique_function<void(T)> callback, T initial_value = T())
+            : ptr(detail::allocate_block<allocated_data_t<Alloc>>(
+                alloc,
+                std::move(initial_value),
+                std::move(callback),
+                alloc))
+        {}
+
+        T& operator* ()
+        {
+            return ptr->data;
+        }
+
+        T* operator-> ()
+        {
+            return &ptr->data;
+        }
+
+        template<typename X>
+        auto setter(X& dst)
+        {
+            return [dst = &dst, holder = ptr](X value) { *dst = std::move(value); };
+        }
+    };
+
+    /// <summary>
+    /// `result` with an error channel: `callback(value, error)` is called once, with `E()` as the error when the last copy is destroyed,
+    /// or right away by the first `fail(error)`, so a fan-in ends at its first error instead of waiting for all siblings.
+    /// `E` is default-constructible and false when it means no error, like `std::exception_ptr` or `std::error_code`.
+    /// Siblings check `failed()` to stop early, or observe the tokens of the `cancellation_source` that the first failure cancels.
+    /// The success path costs as much as `result`: no try/catch, no allocations besides the block.
+    /// </summary>
+    template<typename T, typename E = std::exception_ptr, typename Policy = default_policy>
+    class fallible_result
     {
-        std::shared_ptr<
-            std::pair<
-                std::function<void(const loop&)>,
-                bool>> body;
+        struct data_t : detail::context_block
+        {
+            typename Policy::counter refs;
+            std::atomic<bool> failed{ false };
+            T data;
+            unique_function<void(T, E)> callback;
+
+            data_t(T data, unique_function<void(T, E)> callback)
+                : data(std::move(data))
+                , callback(std::move(callback))
+            {}
+
+            virtual ~data_t()
+            {
+                tracer::result_fired(this);
+                if (callback)
+                    callback(std::move(data), E());
+            }
+
+            virtual void cancel_siblings()
+            {}
+        };
+
+        struct cancelling_data_t final : data_t
+        {
+            cancellation_source source;
+
+            cancelling_data_t(T data, unique_function<void(T, E)> callback, cancellation_source source)
+                : data_t(std::move(data), std::move(callback))
+                , source(std::move(source))
+            {}
+
+            void cancel_siblings() override
+            {
+                source.cancel();
+            }
+        };
+
+        detail::ref_ptr<data_t> ptr;
 
     public:
-        loop(std::function<void(std::function<void()>)> body)
+        fallible_result(unique_function<void(T, E)> callback, T initial_value = T())
+            : ptr(new data_t(std::move(initial_value), std::move(callback)))
+        {}
+
+        // Result, whose first failure also cancels the `source` (on the failing thread, see `cancellation_source`).
+        fallible_result(cancellation_source source, unique_function<void(T, E)> callback, T initial_value = T())
+            : ptr(new cancelling_data_t(std::move(initial_value), std::move(callback), std::move(source)))
+        {}
+
+        T& operator* ()
         {
-            this->body = std::make_shared<
-                std::pair<
-                    std::function<void(const loop&)>,
-                    bool>>(std::move(body), false);
-            operator()();
+            return ptr->data;
+        }
+
+        T* operator-> ()
+        {
+            return &ptr->data;
+        }
+
+        // Calls the callback with the value accumulated so far and the `error`, unless the result has already failed.
+        // Returns false for all failures but the first one.
+        bool fail(E error) const
+        {
+            if (ptr->failed.exchange(true, std::memory_order_acq_rel))
+                return false;
+            unique_function<void(T, E)> callback(std::move(ptr->callback));
+            ptr->cancel_siblings();
+            callback(std::move(ptr->data), std::move(error));
+            return true;
+        }
+
+        bool failed() const
+        {
+            return ptr->failed.load(std::memory_order_relaxed);
+        }
+
+        // Callback holding a copy of the result, that is skipped after a failure and fails the result with
+        // the exception thrown by `f` (`E` is constructed from `std::exception_ptr`) instead of letting it escape.
+        template<typename F>
+        auto guard(F f) const
+        {
+            return [self = *this, f = std::move(f)](auto&&... args) mutable {
+                if (self.failed())
+                    return;
+                try {
+                    f(std::forward<decltype(args)>(args)...);
+                } catch (...) {
+                    self.fail(E(std::current_exception()));
+                }
+            };
         }
+    };
+
+    template<typename T, typename E = std::exception_ptr>
+    using local_fallible_result = fallible_result<T, E, single_threaded>;
+
+    // Joins values of different types coming from parallel requests.
+    // `get<I>()` hands out a move-only setter of the I-th value, each setter can be taken once.
+    // The callback receives all values, when the join object and all its setters are called or destroyed;
+    // values of setters destroyed without a call stay default-constructed.
+    // Setters may be called on different threads, all of them share one block with a single atomic counter.
+    template<typename... Ts>
+    class join
+    {
+        struct block
+        {
+            std::atomic<size_t> pending{ sizeof...(Ts) + 1 };
+            std::tuple<Ts...> values;
+            unique_function<void(Ts...)> callback;
 
-        void operator() ()
+            block(unique_function<void(Ts...)> callback)
+                : callback(std::move(callback))
+            {}
+
+            void arrive(size_t n = 1)
+            {
+                if (pending.fetch_sub(n, std::memory_order_acq_rel) == n) {
+                    tracer::result_fired(this);
+                    std::apply(callback, std::move(values));
+                    delete this;
+                }
+            }
+        };
+
+        block* ptr;
+        size_t taken = 0;  // Bit mask of handed out setters.
+
+    public:
+        template<size_t I>
+        class setter
         {
-            while ((body->second = !body->second))
+            block* ptr;
+
+        public:
+            using value_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+            explicit setter(block* ptr) noexcept
+                : ptr(ptr)
+            {}
+
+            setter(setter&& src) noexcept
+                : ptr(std::exchange(src.ptr, nullptr))
+            {}
+
+            setter& operator= (setter src) noexcept
             {
-                body->first(*this);
+                std::swap(ptr, src.ptr);
+                return *this;
             }
+
+            ~setter()
+            {
+                if (ptr)
+                    ptr->arrive();
+            }
+
+            void operator() (value_type value)
+            {
+                assert(ptr);
+                std::get<I>(ptr->values) = std::move(value);
+                std::exchange(ptr, nullptr)->arrive();
+            }
+        };
+
+        explicit join(unique_function<void(Ts...)> callback)
+            : ptr(new block(std::move(callback)))
+        {
+            static_assert(sizeof...(Ts) < sizeof(size_t) * 8, "too many values");
+        }
+
+        join(join&& src) noexcept
+            : ptr(std::exchange(src.ptr, nullptr))
+            , taken(src.taken)
+        {}
+
+        join(const join&) = delete;
+        void operator= (const join&) = delete;
+
+        ~join()
+        {
+            if (!ptr)
+                return;
+            size_t n = 1;
+            for (size_t i = 0; i < sizeof...(Ts); i++)
+                n += (taken >> i & 1) ? 0 : 1;
+            ptr->arrive(n);
+        }
+
+        template<size_t I>
+        setter<I> get()
+        {
+            static_assert(I < sizeof...(Ts), "no such value");
+            assert(!(taken >> I & 1) && ptr);
+            taken |= size_t(1) << I;
+            return setter<I>(ptr);
         }
     };
 
-    template<typename T>
-    class result
+    namespace detail
     {
-        struct data_t
+        template<typename T, bool = std::is_trivially_copyable_v<T>>
+        constexpr bool is_always_lock_free_v = false;
+
+        template<typename T>
+        constexpr bool is_always_lock_free_v<T, true> = std::atomic<T>::is_always_lock_free;
+    }
+
+    // Thread-safe counterpart of `result`.
+    // Each copy accumulates its own partial value starting from `T()`, which must be the identity of `Combine`.
+    // Destroyed copies combine their partials into the shared block lock-free,
+    // the thread releasing the last copy calls the callback exactly once.
+    template<typename T, typename Combine = std::plus<T>>
+    class concurrent_result
+    {
+        static constexpr bool is_atomic = detail::is_always_lock_free_v<T>;
+
+        struct partial
         {
-            T data;
-            std::function<void(T)> callback;
+            T value;
+            partial* next;
+        };
+
+        struct data_t : detail::context_block
+        {
+            multi_threaded::counter refs;
+            std::conditional_t<is_atomic, std::atomic<T>, T> data;
+            std::atomic<partial*> partials{ nullptr };
+            Combine combine;
+            unique_function<void(T)> callback;
 
-            data_t(T data, std::function<void(T)> callback)
+            data_t(T data, unique_function<void(T)> callback, Combine combine)
                 : data(std::move(data))
+                , combine(std::move(combine))
                 , callback(std::move(callback))
             {}
 
+            void merge(T&& value)
+            {
+                if constexpr (is_atomic) {
+                    T old = data.load(std::memory_order_relaxed);
+                    while (!data.compare_exchange_weak(old, combine(old, value), std::memory_order_release, std::memory_order_relaxed))
+                    {}
+                } else {
+                    auto p = new partial{ std::move(value), partials.load(std::memory_order_relaxed) };
+                    while (!partials.compare_exchange_weak(p->next, p, std::memory_order_release, std::memory_order_relaxed))
+                    {}
+                }
+            }
+
             ~data_t()
             {
-                callback(std::move(data));
+                tracer::result_fired(this);
+                if constexpr (is_atomic) {
+                    callback(data.load(std::memory_order_acquire));
+                } else {
+                    for (auto p = partials.load(std::memory_order_acquire); p;) {
+                        data = combine(std::move(data), std::move(p->value));
+                        delete std::exchange(p, p->next);
+                    }
+                    callback(std::move(data));
+                }
+            }
+        };
+
+        detail::ref_ptr<data_t> ptr;
+        T local = T();
+        bool dirty = false;
+
+        void flush()
+        {
+            if (dirty) {
+                ptr->merge(std::move(local));
+                local = T();
+                dirty = false;
+            }
+        }
+
+    public:
+        concurrent_result(unique_function<void(T)> callback, T initial_value = T(), Combine combine = Combine())
+            : ptr(new data_t(std::move(initial_value), std::move(callback), std::move(combine)))
+        {}
+
+        concurrent_result(const concurrent_result& src)
+            : ptr(src.ptr)
+        {}
+
+        concurrent_result(concurrent_result&& src) noexcept
+            : ptr(std::move(src.ptr))
+            , local(std::move(src.local))
+            , dirty(std::exchange(src.dirty, false))
+        {}
+
+        concurrent_result& operator= (concurrent_result src)
+        {
+            flush();
+            ptr = std::move(src.ptr);
+            local = std::move(src.local);
+            dirty = std::exchange(src.dirty, false);
+            return *this;
+        }
+
+        ~concurrent_result()
+        {
+            if (ptr)
+                flush();
+        }
+
+        // Partial value of this copy; it is combined with others when this copy dies.
+        T& operator* ()
+        {
+            dirty = true;
+            return local;
+        }
+
+        T* operator-> ()
+        {
+            dirty = true;
+            return &local;
+        }
+    };
+
+    namespace detail
+    {
+        // Lanes may call `next()` from any thread: the bookkeeping is guarded by `mutex`, `stream` and `body` are called outside of it,
+        // `stream` by one thread at a time.
+        template<typename Stream, typename Body, typename Result>
+        struct for_each_state : context_block
+        {
+            multi_threaded::counter refs;
+            Stream stream;
+            Body body;
+            Result result;
+            std::mutex mutex;
+            std::vector<loop> idle_lanes;
+            size_t next_lane = 0;
+            bool requesting = false;
+            bool pumping = false;
+            bool ended = false;
+
+            for_each_state(Stream stream, Body body, Result result)
+                : stream(std::move(stream))
+                , body(std::move(body))
+                , result(std::move(result))
+            {}
+
+            void ready(loop lane, const ref_ptr<for_each_state>& self)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (ended)
+                        return;  // The lane is dropped after the unlock.
+                    idle_lanes.push_back(std::move(lane));
+                }
+                pump(self);
+            }
+
+            // Requests items while there are idle lanes, one request at a time; an item delivered on another thread
+            // during a request is picked up by this loop, as that thread's `pump` sees `pumping`.
+            void pump(const ref_ptr<for_each_state>& self)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (pumping)
+                    return;
+                pumping = true;
+                while (!requesting && !ended && next_lane < idle_lanes.size()) {
+                    requesting = true;
+                    lock.unlock();
+                    stream([self](auto item) {
+                        self->on_item(std::move(item), self);
+                    });
+                    lock.lock();
+                }
+                pumping = false;
+            }
+
+            template<typename Item>
+            void on_item(Item item, const ref_ptr<for_each_state>& self)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                requesting = false;
+                if (!item) {
+                    ended = true;
+                    std::vector<loop> dropped(std::move(idle_lanes));
+                    idle_lanes.clear();
+                    lock.unlock();
+                    return;
+                }
+                loop lane = std::move(idle_lanes[next_lane++]);
+                if (next_lane == idle_lanes.size()) {
+                    idle_lanes.clear();
+                    next_lane = 0;
+                }
+                lock.unlock();
+                body(std::move(item), lane, result);
+                pump(self);
+            }
+        };
+    }
+
+    // Runs `body(item, next, result)` for each item of `stream`, keeping at most `max_in_flight` bodies running at once.
+    // The `stream(callback)` is called for one item at a time; it calls `callback(item)`, where falsy `item` ends the stream.
+    // The body calls `next()` when it finishes with its item to take another one (dropping `next` closes one of parallel lanes).
+    // The body can copy the `result` (or any other object passed as `result`) to its callbacks.
+    // It is released when the stream ends and all bodies are done.
+    // Bodies may finish and call `next()` on any thread, e.g. on workers of a `thread_pool_executor`; then bodies run concurrently,
+    // and the `result` should be thread-safe (`concurrent_result`, or a `result` whose value is written under the caller's lock).
+    template<typename Stream, typename Body, typename Result>
+    void parallel_for_each(Stream stream, size_t max_in_flight, Body body, Result result)
+    {
+        using state_t = detail::for_each_state<Stream, Body, Result>;
+        detail::ref_ptr<state_t> state(new state_t(std::move(stream), std::move(body), std::move(result)));
+        for (size_t i = 0; i < max_in_flight; i++) {
+            loop lane([state](auto next) {
+                state->ready(next, state);
+            });
+        }
+    }
+
+    // Drains a batched stream: calls `request(callback)` for the next batch and `body(batch)` for each non-empty batch.
+    // An empty batch (checked with `batch.empty()`) ends the stream.
+    // Batches delivered synchronously are processed by loop iterations, not recursion.
+    template<typename Request, typename Body>
+    void drain_batches(Request request, Body body)
+    {
+        loop draining([request = std::move(request), body = std::move(body)](auto next) mutable {
+            request([&, next](auto batch) {
+                if (batch.empty())
+                    return;
+                body(std::move(batch));
+                next();
+            });
+        });
+    }
+
+    // Runs `body(result)` as a separate task of `ex` holding its own copy of `result` (a `result` or `concurrent_result`),
+    // so the result fires when the task and all tasks it spawned are done.
+    // Called from a `thread_pool_executor` worker, the task goes to this worker's deque: the worker takes its newest subtasks first
+    // and idle workers steal the oldest ones, which are roots of the largest unexplored subtrees, so unbalanced trees spread over
+    // all workers. Results shared by tasks on different threads should be `concurrent_result`s.
+    template<typename Executor, typename Result, typename Body>
+    void spawn(Executor& ex, Result result, Body body)
+    {
+        ex.schedule([result = std::move(result), body = std::move(body)]() mutable {
+            body(result);
+        });
+    }
+
+    // Loop body adaptor running all iterations of `body(next)` on the executor `home` (e.g. a `thread_pool_executor::worker_executor`):
+    // the first iteration is dispatched to `home`, and `next` given to the body dispatches the loop's `next` there,
+    // so calling it from a foreign thread re-posts the iteration to `home`, calling it on `home` continues synchronously.
+    template<typename Executor, typename Body>
+    auto bind_to(Executor home, Body body)
+    {
+        return [home = std::move(home), body = std::move(body), started = false](const auto& next) mutable {
+            auto resume = [home, next] {
+                home.dispatch([next] { next(); });
+            };
+            if (std::exchange(started, true))
+                body(resume);
+            else
+                resume();
+        };
+    }
+
+    /// <summary>
+    /// Structured concurrency scope (nursery): `on_done(error)` is called once the scope object and all its children are gone.
+    /// Children are loops started with `spawn` and any other work holding a reference taken with `enter()`.
+    /// References are move-only, so a child costs one counter increment and decrement on the shared block however its
+    /// continuations are copied, unlike a `result` captured by each of them.
+    /// `fail(error)` keeps the first error for `on_done`, spawned loops stop at their next iteration after it and
+    /// an exception thrown by a spawned loop body fails the scope.
+    /// </summary>
+    template<typename Policy = default_policy>
+    class basic_scope
+    {
+        struct block : detail::context_block
+        {
+            typename Policy::counter refs;
+            std::atomic<bool> failed{ false };
+            std::exception_ptr error;  // written once by the first `fail`, read by the last reference
+            unique_function<void(std::exception_ptr)> on_done;
+
+            block(unique_function<void(std::exception_ptr)> on_done)
+                : on_done(std::move(on_done))
+            {}
+
+            void destroy()
+            {
+                unique_function<void(std::exception_ptr)> callback(std::move(on_done));
+                std::exception_ptr e(std::move(error));
+                delete this;
+                if (callback)
+                    callback(std::move(e));
             }
         };
 
-        std::shared_ptr<data_t> ptr;
+        detail::ref_ptr<block> ptr;
+
+        explicit basic_scope(detail::ref_ptr<block> ptr)
+            : ptr(std::move(ptr))
+        {}
+
+    public:
+        explicit basic_scope(unique_function<void(std::exception_ptr)> on_done)
+            : ptr(new block(std::move(on_done)))
+        {}
+
+        basic_scope(basic_scope&&) noexcept = default;
+        basic_scope& operator= (basic_scope&&) noexcept = default;
+
+        // Another reference keeping the scope open, e.g. for a callback of an async operation.
+        basic_scope enter() const
+        {
+            return basic_scope(ptr);
+        }
+
+        // Starts a child loop, whose body is `body(next)` or `body(next, scope)` with the reference the loop holds.
+        template<typename Body>
+        void spawn(Body body) const
+        {
+            auto child = [self = enter(), body = std::move(body)](auto next) mutable {
+                if (self.failed())
+                    return;
+                try {
+                    if constexpr (std::is_invocable_v<Body&, decltype(next), const basic_scope&>)
+                        body(next, std::as_const(self));
+                    else
+                        body(next);
+                } catch (...) {
+                    self.fail(std::current_exception());
+                }
+            };
+            basic_loop<decltype(child), Policy> start(std::move(child));
+        }
+
+        // Keeps the first error, later ones are ignored.
+        void fail(std::exception_ptr error) const
+        {
+            if (!ptr->failed.exchange(true, std::memory_order_acq_rel))
+                ptr->error = std::move(error);
+        }
+
+        bool failed() const
+        {
+            return ptr->failed.load(std::memory_order_relaxed);
+        }
+    };
+
+    using scope = basic_scope<>;
+    using local_scope = basic_scope<single_threaded>;
+
+    // Monotonic allocator for the control blocks of one async operation (e.g. one request handler).
+    // Allocations are carved sequentially from chunks, deallocations are no-ops,
+    // all memory is released at once when the arena is destroyed.
+    // Allocations are not synchronized, deallocations may happen on any thread.
+    class arena
+    {
+        struct chunk
+        {
+            chunk* prev;
+        };
+
+        chunk* chunks = nullptr;
+        char* current = nullptr;
+        char* end = nullptr;
+        size_t chunk_size;
+        size_t used = 0;
+
+    public:
+        explicit arena(size_t chunk_size = 4096)
+            : chunk_size(chunk_size)
+        {}
+
+        // Starts with the caller-provided buffer (e.g. on stack), that should outlive the arena.
+        arena(void* buffer, size_t size, size_t chunk_size = 4096)
+            : current(static_cast<char*>(buffer))
+            , end(static_cast<char*>(buffer) + size)
+            , chunk_size(chunk_size)
+        {}
+
+        arena(const arena&) = delete;
+        void operator= (const arena&) = delete;
+
+        ~arena()
+        {
+            while (chunks)
+                ::operator delete(std::exchange(chunks, chunks->prev));
+        }
+
+        void* allocate(size_t size, size_t align)
+        {
+            auto aligned = [&] {
+                return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(current) + align - 1) & ~uintptr_t(align - 1));
+            };
+            char* p = aligned();
+            if (!current || p > end || size > size_t(end - p)) {  // Aligning may step past the end.
+                size_t bytes = sizeof(chunk) + align + (size > chunk_size ? size : chunk_size);
+                auto c = static_cast<chunk*>(::operator new(bytes));
+                c->prev = chunks;
+                chunks = c;
+                current = reinterpret_cast<char*>(c + 1);
+                end = reinterpret_cast<char*>(c) + bytes;
+                p = aligned();
+            }
+            current = p + size;
+            used += size;
+            return p;
+        }
+
+        // Total size of all allocations made in this arena.
+        size_t allocated() const
+        {
+            return used;
+        }
+    };
+
+    template<typename T>
+    class arena_allocator
+    {
+        template<typename U>
+        friend class arena_allocator;
+
+        arena* source;
 
     public:
-        result(std::function<void(T)> callback, T initial_value = T())
-            : ptr(std::make_shared<data_t>(
-                std::move(initial_value),
-                std::move(callback)))
+        using value_type = T;
+
+        arena_allocator(arena& source) noexcept
+            : source(&source)
         {}
 
-        T& operator* ()
+        template<typename U>
+        arena_allocator(const arena_allocator<U>& src) noexcept
+            : source(src.source)
+        {}
+
+        T* allocate(size_t n)
         {
-            return ptr->data;
+            return static_cast<T*>(source->allocate(n * sizeof(T), alignof(T)));
         }
 
-        T* operator-> ()
+        void deallocate(T*, size_t) noexcept
+        {}
+
+        template<typename U>
+        bool operator== (const arena_allocator<U>& other) const noexcept
         {
-            return &ptr->data;
+            return source == other.source;
         }
 
-        template<typename X>
-        function<void(X)> setter(X& dst)
+        template<typename U>
+        bool operator!= (const arena_allocator<U>& other) const noexcept
         {
-            return [dst = &dst, holder = ptr](X value) { *dst = move(value); };
+            return source != other.source;
         }
     };
 
@@ -115,67 +1586,649 @@ namespace l_async
         void operator= (const unique<T>&) = delete;
     };
 
-    template <typename T>
+    template <typename T, typename Policy = default_policy>
     class slot
     {
-        struct data
+        // Slot copies hold strong references, providers hold weak ones.
+        // The listeners are dropped with the last strong reference, the block is freed with the last weak one.
+        // Either the provider waits for a request or the consumer waits for data, so both listeners share storage
+        // and the block of a multi-threaded slot takes one cache line.
+        struct data : detail::context_block
+        {
+            enum class side : unsigned char { none, provider, consumer };
+
+            typename Policy::counter refs;
+            typename Policy::counter weak_refs;
+            union
+            {
+                unique_function<void()> who_awaits_request;
+                unique_function<void(T)> who_awaits_data;
+            };
+            side who_waits = side::none;
+            bool cancelled = false;
+
+            data() {}
+
+            virtual ~data()
+            {
+                drop_listener();
+            }
+
+            virtual void deallocate()
+            {
+                delete this;
+            }
+
+            bool awaits_request() const { return who_waits == side::provider; }
+            bool awaits_data() const { return who_waits == side::consumer; }
+
+            template<typename F>
+            void set_request_listener(F&& listener)
+            {
+                assert(who_waits == side::none);
+                new (&who_awaits_request) unique_function<void()>(std::forward<F>(listener));
+                who_waits = side::provider;
+            }
+
+            void set_data_listener(unique_function<void(T)>&& listener)
+            {
+                assert(who_waits == side::none);
+                new (&who_awaits_data) unique_function<void(T)>(std::move(listener));
+                who_waits = side::consumer;
+            }
+
+            unique_function<void()> take_request_listener()
+            {
+                assert(awaits_request());
+                unique_function<void()> listener(std::move(who_awaits_request));
+                std::destroy_at(&who_awaits_request);
+                who_waits = side::none;
+                return listener;
+            }
+
+            unique_function<void(T)> take_data_listener()
+            {
+                assert(awaits_data());
+                unique_function<void(T)> listener(std::move(who_awaits_data));
+                std::destroy_at(&who_awaits_data);
+                who_waits = side::none;
+                return listener;
+            }
+
+            // The listener is destroyed after the slot has no waiting side, so its captures can use the slot.
+            void drop_listener()
+            {
+                if (awaits_request())
+                    take_request_listener();
+                else if (awaits_data())
+                    take_data_listener();
+            }
+
+            void destroy()
+            {
+                drop_listener();
+                release_weak();
+            }
+
+            void release_weak()
+            {
+                if (weak_refs.release())
+                    deallocate();
+            }
+        };
+
+        template<typename Alloc>
+        struct allocated_data final : data
         {
-            std::function<void()> who_awaits_request;
-            std::function<void(T)> who_awaits_data;
+            Alloc alloc;
+
+            allocated_data(const Alloc& alloc)
+                : alloc(alloc)
+            {}
+
+            void deallocate() override
+            {
+                detail::deallocate_block(alloc, this);
+            }
+        };
+
+        struct cancellable_data : data
+        {
+            cancellation_subscription subscription;
+
+            cancellable_data(const cancellation_token& token)
+                : subscription(token, [this] {
+                    this->cancelled = true;
+                    this->drop_listener();
+                })
+            {}
+        };
+
+        // Marks the request listener running inline on this thread, so a provider called from it can skip `lock`.
+        // The mark is thread-local: a provider called on another thread meanwhile takes the locking path.
+        struct sync_scope
+        {
+            const void*& current;
+            const void* outer;
+
+            explicit sync_scope(data& d)
+                : current(detail::sync_request_slot())
+                , outer(std::exchange(current, &d))
+            {}
+
+            ~sync_scope()
+            {
+                current = outer;
+            }
         };
-        std::shared_ptr<data> ptr;
+
+        detail::ref_ptr<data> ptr;
 
     public:
         class provider
         {
-            std::weak_ptr<data> ptr;
+            detail::weak_ref_ptr<data> ptr;
+
+            static void deliver(data& d, T&& value)
+            {
+                if (d.cancelled)
+                    return;
+                assert(d.awaits_data());
+                tracer::slot_delivered(&d);
+                unique_function<void(T)> temp(d.take_data_listener());  // Moved out, as the listener may request the next value.
+                temp(std::move(value));
+            }
 
         public:
-            provider(std::weak_ptr<data> ptr)
+            provider(detail::weak_ref_ptr<data> ptr)
                 : ptr(std::move(ptr))
             {}
 
-            void await(std::function<void()> request_listener) const
+            // A consumer already waiting gets the listener called inline, without type erasure.
+            template<typename F>
+            void await(F&& request_listener) const
             {
                 if (auto p = ptr.lock()) {
-                    assert(!p->who_awaits_request);
-                    if (p->who_awaits_data) {
+                    assert(!p->awaits_request());
+                    if (p->cancelled) {
+                        return;
+                    } else if (p->awaits_data()) {
+                        sync_scope s(*p);
                         request_listener();
                     } else {
-                        p->who_awaits_request = move(request_listener);
+                        p->set_request_listener(std::forward<F>(request_listener));
                     }
                 }
             }
 
+            // Called from a request listener running inline on this thread (the synchronous provider case), passes the value without `lock`.
             void operator() (T value) const
             {
-                if (auto p = ptr.lock()) {
-                    assert(p->who_awaits_data);
-                    std::function<void(T)> temp;
-                    std::swap(temp, p->who_awaits_data);
-                    temp(std::move(value));
+                if (data* d = ptr.get(); d && detail::sync_request_slot() == d) {
+                    deliver(*d, std::move(value));
+                } else if (auto p = ptr.lock()) {
+                    deliver(*p, std::move(value));
                 }
             }
         };
 
         slot()
-            : ptr(std::make_shared<data>())
+            : ptr(new data())
+        {}
+
+        template<typename Alloc>
+        slot(std::allocator_arg_t, const Alloc& alloc)
+            : ptr(detail::allocate_block<allocated_data<Alloc>>(alloc, alloc))
+        {}
+
+        // Slot, that drops its pending listeners when the `token` is cancelled and ignores all later requests and values.
+        explicit slot(const cancellation_token& token)
+            : ptr(new cancellable_data(token))
         {}
 
-        void operator() (std::function<void(T)> data_listener)
+        void operator() (unique_function<void(T)> data_listener)
         {
-            assert(!ptr->who_awaits_data);
-            ptr->who_awaits_data = std::move(data_listener);
-            if (ptr->who_awaits_request) {
-                std::function<void()> temp;
-                std::swap(temp, ptr->who_awaits_request);
+            if (ptr->cancelled)
+                return;
+            assert(!ptr->awaits_data());
+            tracer::slot_awaited(ptr.get());
+            if (ptr->awaits_request()) {
+                unique_function<void()> temp(ptr->take_request_listener());
+                ptr->set_data_listener(std::move(data_listener));
+                detail::ref_ptr<data> hold(ptr);  // The listener may release this slot.
+                sync_scope s(*hold);
                 temp();
+            } else {
+                ptr->set_data_listener(std::move(data_listener));
+            }
+        }
+
+        provider get_provider()
+        {
+            return provider{ detail::weak_ref_ptr<data>(ptr) };
+        }
+    };
+
+    template<typename T>
+    using local_result = result<T, single_threaded>;
+
+    template<typename T>
+    using local_slot = slot<T, single_threaded>;
+
+    // Slot with a ring buffer of `N` items.
+    // Provider's `await` listener is called as long as the buffer has space, so the provider runs ahead of the consumer;
+    // when the buffer is full, it waits till the consumer takes items.
+    // Consumer takes items one by one with `operator()` or all buffered items at once with `drain`.
+    template<typename T, size_t N>
+    class channel
+    {
+        static_assert(N > 0, "use slot for unbuffered handoff");
+
+    public:
+        // Most items passed to one `drain` listener, they are moved to the stack for the call.
+        static constexpr size_t max_batch = N < 64 ? N : 64;
+
+        // Items taken from the buffer, valid only in scope of the `drain` listener.
+        class batch
+        {
+            T* items;
+            size_t n;
+
+        public:
+            batch(T* items, size_t n)
+                : items(items)
+                , n(n)
+            {}
+
+            size_t size() const { return n; }
+            T& operator[] (size_t i) const { return items[i]; }
+            T* begin() const { return items; }
+            T* end() const { return items + n; }
+        };
+
+    private:
+        struct cell
+        {
+            alignas(T) unsigned char bytes[sizeof(T)];
+        };
+
+        // Channel copies hold strong references, providers hold weak ones, as in `slot`.
+        struct data : detail::context_block
+        {
+            multi_threaded::counter refs;
+            multi_threaded::counter weak_refs;
+            unique_function<void()> who_awaits_space;
+            unique_function<void(T)> who_awaits_data;
+            unique_function<void(batch)> who_awaits_batch;
+            cell items[N];
+            size_t head = 0;
+            size_t count = 0;
+
+            T& at(size_t i)
+            {
+                return *std::launder(reinterpret_cast<T*>(items[(head + i) % N].bytes));
+            }
+
+            void push(T&& value)
+            {
+                assert(count < N);
+                new (items[(head + count) % N].bytes) T(std::move(value));
+                count++;
+            }
+
+            void drop_front()
+            {
+                at(0).~T();
+                head = (head + 1) % N;
+                count--;
+            }
+
+            T pop()
+            {
+                T r = std::move(at(0));
+                drop_front();
+                return r;
+            }
+
+            // Moves up to `max_batch` items out of the ring, so the listener can restart the consumer and the provider can refill the buffer.
+            // Called with a strong reference held by the caller, the listener may release the rest.
+            void deliver_batch(unique_function<void(batch)> listener)
+            {
+                cell taken[max_batch];
+                size_t n = count < max_batch ? count : max_batch;
+                for (size_t i = 0; i < n; i++)
+                    new (taken[i].bytes) T(pop());
+                T* first = std::launder(reinterpret_cast<T*>(taken[0].bytes));
+                listener(batch(first, n));
+                for (size_t i = 0; i < n; i++)
+                    first[i].~T();
+                wake_provider();
+            }
+
+            void wake_provider()
+            {
+                if (who_awaits_space && count < N) {
+                    unique_function<void()> temp(std::move(who_awaits_space));
+                    temp();
+                }
+            }
+
+            virtual ~data()
+            {
+                while (count)
+                    drop_front();
+            }
+
+            virtual void deallocate()
+            {
+                delete this;
             }
+
+            // Drops listeners and buffered items with the last strong reference.
+            void destroy()
+            {
+                unique_function<void()> space(std::move(who_awaits_space));
+                unique_function<void(T)> listener(std::move(who_awaits_data));
+                unique_function<void(batch)> batch_listener(std::move(who_awaits_batch));
+                while (count)
+                    drop_front();
+                release_weak();
+            }
+
+            void release_weak()
+            {
+                if (weak_refs.release())
+                    deallocate();
+            }
+        };
+
+        template<typename Alloc>
+        struct allocated_data final : data
+        {
+            Alloc alloc;
+
+            allocated_data(const Alloc& alloc)
+                : alloc(alloc)
+            {}
+
+            void deallocate() override
+            {
+                detail::deallocate_block(alloc, this);
+            }
+        };
+
+        detail::ref_ptr<data> ptr;
+
+    public:
+        class provider
+        {
+            detail::weak_ref_ptr<data> ptr;
+
+        public:
+            provider(detail::weak_ref_ptr<data> ptr)
+                : ptr(std::move(ptr))
+            {}
+
+            // Calls `space_listener` as soon as the buffer has space for one more item.
+            void await(unique_function<void()> space_listener) const
+            {
+                if (auto p = ptr.lock()) {
+                    assert(!p->who_awaits_space);
+                    if (p->count < N) {
+                        space_listener();
+                    } else {
+                        p->who_awaits_space = std::move(space_listener);
+                    }
+                }
+            }
+
+            void operator() (T value) const
+            {
+                if (auto p = ptr.lock()) {
+                    if (p->who_awaits_data) {
+                        assert(p->count == 0);
+                        tracer::slot_delivered(p.get());
+                        unique_function<void(T)> temp(std::move(p->who_awaits_data));
+                        temp(std::move(value));
+                    } else if (p->who_awaits_batch) {
+                        assert(p->count == 0);
+                        tracer::slot_delivered(p.get());
+                        unique_function<void(batch)> temp(std::move(p->who_awaits_batch));
+                        temp(batch(&value, 1));
+                    } else {
+                        p->push(std::move(value));
+                    }
+                }
+            }
+        };
+
+        channel()
+            : ptr(new data())
+        {}
+
+        template<typename Alloc>
+        channel(std::allocator_arg_t, const Alloc& alloc)
+            : ptr(detail::allocate_block<allocated_data<Alloc>>(alloc, alloc))
+        {}
+
+        void operator() (unique_function<void(T)> data_listener)
+        {
+            assert(!ptr->who_awaits_data && !ptr->who_awaits_batch);
+            if (ptr->count) {
+                detail::ref_ptr<data> hold(ptr);  // The listener may destroy this channel.
+                data_listener(hold->pop());
+                hold->wake_provider();
+            } else {
+                tracer::slot_awaited(ptr.get());
+                ptr->who_awaits_data = std::move(data_listener);
+            }
+        }
+
+        // Passes currently buffered items (up to `max_batch` of them) or the first delivered one to the listener in one call.
+        // Items are removed from the buffer before the call.
+        void drain(unique_function<void(batch)> batch_listener)
+        {
+            assert(!ptr->who_awaits_data && !ptr->who_awaits_batch);
+            if (ptr->count) {
+                detail::ref_ptr<data> hold(ptr);  // The listener may destroy this channel.
+                hold->deliver_batch(std::move(batch_listener));
+            } else {
+                tracer::slot_awaited(ptr.get());
+                ptr->who_awaits_batch = std::move(batch_listener);
+            }
+        }
+
+        provider get_provider()
+        {
+            return provider{ detail::weak_ref_ptr<data>(ptr) };
+        }
+    };
+
+    // Slot with many consumers: each value is delivered to all current subscribers, that share its const ownership.
+    // Provider's `await` listener is called when every subscriber waits for the next value, so the slowest one sets the pace.
+    // Values delivered regardless of `await` are queued for subscribers that have not requested them yet, their next requests take them.
+    // Subscribers are taken with `subscribe()` and leave when destroyed; values delivered before a subscription are not replayed.
+    template<typename T, typename Policy = default_policy>
+    class broadcast_slot
+    {
+    public:
+        using value_ptr = std::shared_ptr<const T>;
+
+    private:
+        // The slot and its subscribers hold strong references, providers hold weak ones.
+        struct data : detail::context_block
+        {
+            typename Policy::counter refs;
+            typename Policy::counter weak_refs;
+            struct subscription
+            {
+                unique_function<void(value_ptr)> who_awaits_data;
+                std::vector<value_ptr> backlog;  // values delivered while the subscriber did not wait
+                size_t backlog_head = 0;
+                bool active = false;
+            };
+
+            unique_function<void()> who_awaits_request;
+            std::vector<subscription> subscriptions;  // by subscriber index
+            std::vector<size_t> free_indices;
+            std::vector<unique_function<void(value_ptr)>> spare_batch;  // reused by deliveries
+            size_t subscribers = 0;
+            size_t waiting = 0;
+
+            void destroy()
+            {
+                unique_function<void()> request(std::move(who_awaits_request));
+                auto listeners(std::move(subscriptions));
+                release_weak();
+            }
+
+            void release_weak()
+            {
+                if (weak_refs.release())
+                    delete this;
+            }
+
+            // Called with a strong reference held by the caller, the listener may release the rest.
+            void request_if_all_wait()
+            {
+                if (who_awaits_request && subscribers && waiting == subscribers) {
+                    unique_function<void()> temp(std::move(who_awaits_request));
+                    temp();
+                }
+            }
+        };
+
+        detail::ref_ptr<data> ptr;
+
+    public:
+        class provider
+        {
+            detail::weak_ref_ptr<data> ptr;
+
+        public:
+            provider(detail::weak_ref_ptr<data> ptr)
+                : ptr(std::move(ptr))
+            {}
+
+            template<typename F>
+            void await(F&& request_listener) const
+            {
+                if (auto p = ptr.lock()) {
+                    assert(!p->who_awaits_request);
+                    if (p->subscribers && p->waiting == p->subscribers) {
+                        request_listener();
+                    } else {
+                        p->who_awaits_request = std::forward<F>(request_listener);
+                    }
+                }
+            }
+
+            // Passes one shared copy of the value to every waiting subscriber, they can request the next one from their listeners.
+            // Other subscribers get it with their next requests.
+            void operator() (T value) const
+            {
+                if (auto p = ptr.lock()) {
+                    tracer::slot_delivered(p.get());
+                    value_ptr shared = std::make_shared<const T>(std::move(value));
+                    auto batch(std::move(p->spare_batch));
+                    for (auto& s : p->subscriptions) {
+                        if (s.who_awaits_data)
+                            batch.push_back(std::move(s.who_awaits_data));
+                        else if (s.active)
+                            s.backlog.push_back(shared);
+                    }
+                    p->waiting = 0;
+                    for (auto& listener : batch)
+                        listener(shared);
+                    batch.clear();
+                    p->spare_batch = std::move(batch);
+                }
+            }
+        };
+
+        class subscriber
+        {
+            detail::ref_ptr<data> ptr;
+            size_t index = 0;
+
+        public:
+            explicit subscriber(detail::ref_ptr<data> src)
+                : ptr(std::move(src))
+            {
+                if (ptr->free_indices.empty()) {
+                    index = ptr->subscriptions.size();
+                    ptr->subscriptions.emplace_back();
+                } else {
+                    index = ptr->free_indices.back();
+                    ptr->free_indices.pop_back();
+                }
+                ptr->subscriptions[index].active = true;
+                ptr->subscribers++;
+            }
+
+            subscriber(subscriber&& src) noexcept
+                : ptr(std::move(src.ptr))
+                , index(src.index)
+            {}
+
+            subscriber& operator= (subscriber src) noexcept
+            {
+                std::swap(ptr, src.ptr);
+                std::swap(index, src.index);
+                return *this;
+            }
+
+            // Leaving lets the provider go on, if the rest of subscribers wait.
+            ~subscriber()
+            {
+                if (!ptr)
+                    return;
+                auto& s = ptr->subscriptions[index];
+                unique_function<void(value_ptr)> listener(std::move(s.who_awaits_data));
+                if (listener)
+                    ptr->waiting--;
+                s.backlog.clear();
+                s.backlog_head = 0;
+                s.active = false;
+                ptr->subscribers--;
+                ptr->free_indices.push_back(index);
+                ptr->request_if_all_wait();
+            }
+
+            void operator() (unique_function<void(value_ptr)> data_listener)
+            {
+                auto& s = ptr->subscriptions[index];
+                assert(!s.who_awaits_data);
+                if (s.backlog_head < s.backlog.size()) {
+                    value_ptr value(std::move(s.backlog[s.backlog_head++]));
+                    if (s.backlog_head == s.backlog.size()) {
+                        s.backlog.clear();
+                        s.backlog_head = 0;
+                    }
+                    data_listener(std::move(value));  // May release this subscriber.
+                    return;
+                }
+                tracer::slot_awaited(ptr.get());
+                s.who_awaits_data = std::move(data_listener);
+                if (++ptr->waiting == ptr->subscribers && ptr->who_awaits_request) {
+                    detail::ref_ptr<data> hold(ptr);  // The request listener may release this subscriber.
+                    hold->request_if_all_wait();
+                }
+            }
+        };
+
+        broadcast_slot()
+            : ptr(new data())
+        {}
+
+        subscriber subscribe()
+        {
+            return subscriber(ptr);
         }
 
         provider get_provider()
         {
-            return provider{ std::weak_ptr<data>(ptr) };
+            return provider{ detail::weak_ref_ptr<data>(ptr) };
         }
     };
 }
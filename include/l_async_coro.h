@@ -0,0 +1,359 @@
+#ifndef _L_ASYNC_CORO_H_
+#define _L_ASYNC_CORO_H_
+
+// C++20 coroutine adapters for l_async primitives:
+// - `task<T>` - lazily started coroutine, that can be awaited by other tasks or started on any executor having `schedule()`,
+// - `co_await slot` / `co_await l_async::request(stream)` - requests the next value from a provider,
+// - `awaitable_result<T>` - a `result<T>` that can be joined by `co_await`,
+// - `co_await l_async::schedule_on(executor)` - continues the coroutine on the executor.
+
+#if !defined(__cpp_impl_coroutine)
+#error "l_async_coro.h requires C++20 coroutines"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <cstddef>
+#include <new>
+
+#include "l_async.h"
+
+namespace l_async
+{
+    namespace detail
+    {
+        // Thread-local size-class free lists for coroutine frames.
+        class frame_pool
+        {
+            static constexpr size_t granularity = 64;
+            static constexpr size_t classes = 16;
+
+            struct free_frame
+            {
+                free_frame* next;
+            };
+
+            free_frame* lists[classes] = {};
+
+            static frame_pool& local()
+            {
+                static thread_local frame_pool pool;
+                return pool;
+            }
+
+            ~frame_pool()
+            {
+                for (auto& list : lists) {
+                    while (list)
+                        ::operator delete(std::exchange(list, list->next));
+                }
+            }
+
+        public:
+            static void* allocate(size_t size)
+            {
+                size_t c = (size + granularity - 1) / granularity;
+                if (c >= classes)
+                    return ::operator new(size);
+                auto& list = local().lists[c];
+                if (!list)
+                    return ::operator new(c * granularity);
+                return std::exchange(list, list->next);
+            }
+
+            static void deallocate(void* p, size_t size) noexcept
+            {
+                size_t c = (size + granularity - 1) / granularity;
+                if (c >= classes) {
+                    ::operator delete(p);
+                    return;
+                }
+                auto& list = local().lists[c];
+                list = new (p) free_frame{ list };
+            }
+        };
+
+        // Hands a value from a callback to a coroutine.
+        // If the callback is called before the coroutine is suspended, the coroutine doesn't suspend at all,
+        // so synchronous providers don't grow the stack.
+        template<typename T>
+        class handoff
+        {
+            enum : int { waiting, delivered, suspended };
+
+            std::atomic<int> state{ waiting };
+            std::coroutine_handle<> continuation;
+
+        public:
+            std::optional<T> value;
+
+            void deliver(T v)
+            {
+                value.emplace(std::move(v));
+                if (state.exchange(delivered, std::memory_order_acq_rel) == suspended)
+                    continuation.resume();
+            }
+
+            // Returns false if the value has been already delivered.
+            bool suspend(std::coroutine_handle<> h)
+            {
+                continuation = h;
+                return state.exchange(suspended, std::memory_order_acq_rel) == waiting;
+            }
+        };
+
+        template<typename T>
+        struct task_result
+        {
+            std::optional<T> value;
+
+            template<typename V>
+            void return_value(V&& v)
+            {
+                value.emplace(std::forward<V>(v));
+            }
+
+            T take() { return std::move(*value); }
+        };
+
+        template<>
+        struct task_result<void>
+        {
+            void return_void() {}
+            void take() {}
+        };
+    }
+
+    /// <summary>
+    /// Lazily started coroutine.
+    /// It can be awaited by another coroutine or started on an executor with `start`.
+    /// Completion transfers control directly to the awaiting coroutine (symmetric transfer), so chains of tasks don't grow the stack
+    /// in optimized builds, where compilers turn this transfer into a tail call.
+    /// </summary>
+    template<typename T = void>
+    class task
+    {
+    public:
+        using callback_t = std::conditional_t<std::is_void_v<T>, unique_function<void()>, unique_function<void(T)>>;
+
+        struct promise_type : detail::task_result<T>
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+            callback_t on_done;
+            unique_function<void(std::exception_ptr)> on_error;
+            bool detached = false;
+
+            task get_return_object()
+            {
+                return task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct final_awaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    auto& p = h.promise();
+                    if (!p.detached)
+                        return p.continuation ? p.continuation : std::noop_coroutine();
+                    if (p.exception) {
+                        // A detached task has nobody to rethrow to, and an exception can't leave `noexcept` `await_suspend`.
+                        if (!p.on_error)
+                            std::terminate();
+                        auto on_error = std::move(p.on_error);
+                        auto exception = std::move(p.exception);
+                        h.destroy();
+                        on_error(std::move(exception));
+                        return std::noop_coroutine();
+                    }
+                    if (p.on_done) {
+                        if constexpr (std::is_void_v<T>)
+                            p.on_done();
+                        else
+                            p.on_done(p.take());
+                    }
+                    h.destroy();
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            final_awaiter final_suspend() noexcept { return {}; }
+
+            void unhandled_exception() { exception = std::current_exception(); }
+
+            static void* operator new(size_t size) { return detail::frame_pool::allocate(size); }
+            static void operator delete(void* p, size_t size) noexcept { detail::frame_pool::deallocate(p, size); }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> h;
+
+        explicit task(std::coroutine_handle<promise_type> h)
+            : h(h)
+        {}
+
+    public:
+        task(task&& src) noexcept
+            : h(std::exchange(src.h, nullptr))
+        {}
+
+        task& operator= (task src) noexcept
+        {
+            std::swap(h, src.h);
+            return *this;
+        }
+
+        ~task()
+        {
+            if (h)
+                h.destroy();
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct awaiter
+            {
+                std::coroutine_handle<promise_type> h;
+
+                bool await_ready() noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+                {
+                    h.promise().continuation = caller;
+                    return h;
+                }
+
+                T await_resume()
+                {
+                    if (h.promise().exception)
+                        std::rethrow_exception(h.promise().exception);
+                    return h.promise().take();
+                }
+            };
+            return awaiter{ h };
+        }
+
+        /// <summary>
+        /// Detaches the task and starts it on the executor, the task frame is destroyed on completion.
+        /// `on_done` receives the task result, `on_error` the exception that escaped the task;
+        /// without `on_error` such an exception calls `std::terminate`.
+        /// </summary>
+        template<typename Executor>
+        void start(Executor& executor, callback_t on_done = nullptr, unique_function<void(std::exception_ptr)> on_error = nullptr) &&
+        {
+            auto frame = std::exchange(h, nullptr);
+            frame.promise().detached = true;
+            frame.promise().on_done = std::move(on_done);
+            frame.promise().on_error = std::move(on_error);
+            executor.schedule([frame] { frame.resume(); });
+        }
+    };
+
+    /// <summary>
+    /// Awaitable that resumes the coroutine on the given executor.
+    /// </summary>
+    template<typename Executor>
+    auto schedule_on(Executor& executor)
+    {
+        struct awaiter
+        {
+            Executor& executor;
+
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { executor.schedule([h] { h.resume(); }); }
+            void await_resume() noexcept {}
+        };
+        return awaiter{ executor };
+    }
+
+    /// <summary>
+    /// Awaitable that requests one value of type `T` from the `provider`, that is called as `provider(callback)`.
+    /// Suitable for `slot`, `channel` and all `function<void(function<void(T)>)>` streams.
+    /// </summary>
+    template<typename T, typename Provider>
+    auto request(Provider& provider)
+    {
+        struct awaiter
+        {
+            Provider& provider;
+            detail::handoff<T> handoff;
+
+            bool await_ready() noexcept { return false; }
+
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                provider([this](T v) { handoff.deliver(std::move(v)); });
+                return handoff.suspend(h);
+            }
+
+            T await_resume() { return std::move(*handoff.value); }
+        };
+        return awaiter{ provider, {} };
+    }
+
+    template<typename T, typename Policy>
+    auto operator co_await(slot<T, Policy>& s)
+    {
+        return request<T>(s);
+    }
+
+    template<typename T, size_t N>
+    auto operator co_await(channel<T, N>& c)
+    {
+        return request<T>(c);
+    }
+
+    /// <summary>
+    /// Holds a `result<T>` that can be copied to parallel branches with `get()`.
+    /// `co_await std::move(r)` drops the own copy and resumes the coroutine, when all branches released theirs.
+    /// </summary>
+    template<typename T>
+    class awaitable_result
+    {
+        detail::handoff<T> handoff;
+        std::optional<result<T>> r;
+
+    public:
+        explicit awaitable_result(T initial_value = T())
+            : r(std::in_place, [this](T v) { handoff.deliver(std::move(v)); }, std::move(initial_value))
+        {}
+
+        awaitable_result(const awaitable_result&) = delete;
+        void operator= (const awaitable_result&) = delete;
+
+        result<T>& get()
+        {
+            return *r;
+        }
+
+        auto operator co_await() &&
+        {
+            struct awaiter
+            {
+                awaitable_result& self;
+
+                bool await_ready() noexcept { return false; }
+
+                bool await_suspend(std::coroutine_handle<> h)
+                {
+                    self.r.reset();
+                    return self.handoff.suspend(h);
+                }
+
+                T await_resume() { return std::move(*self.handoff.value); }
+            };
+            return awaiter{ *this };
+        }
+    };
+}
+
+#endif  // _L_ASYNC_CORO_H_
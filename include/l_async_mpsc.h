@@ -0,0 +1,143 @@
+#ifndef _L_ASYNC_MPSC_H_
+#define _L_ASYNC_MPSC_H_
+
+#include <atomic>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace l_async
+{
+    /// <summary>
+    /// Intrusive multi-producer single-consumer queue (D. Vyukov's algorithm).
+    /// `Node` has `std::atomic<Node*> next`, nodes are owned by the caller while queued.
+    /// `push` is wait-free (one exchange and one store) and can be called from any thread,
+    /// `pop` and `empty` only from the consumer thread.
+    /// </summary>
+    template<typename Node>
+    class mpsc_queue
+    {
+        Node stub;
+        std::atomic<Node*> tail{ &stub };  // Last pushed node, producers' end.
+        Node* head = &stub;                // Consumer's end.
+
+    public:
+        mpsc_queue() = default;
+        mpsc_queue(const mpsc_queue&) = delete;
+        void operator= (const mpsc_queue&) = delete;
+
+        void push(Node* n) noexcept
+        {
+            n->next.store(nullptr, std::memory_order_relaxed);
+            Node* prev = tail.exchange(n, std::memory_order_seq_cst);
+            prev->next.store(n, std::memory_order_release);
+        }
+
+        // Takes the oldest node, returns null if the queue is empty or its oldest node is being linked by a producer
+        // (`empty()` tells these cases apart).
+        Node* pop() noexcept
+        {
+            Node* h = head;
+            Node* next = h->next.load(std::memory_order_acquire);
+            if (h == &stub) {
+                if (!next)
+                    return nullptr;
+                head = h = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next) {
+                head = next;
+                return h;
+            }
+            if (h != tail.load(std::memory_order_acquire))
+                return nullptr;
+            push(&stub);  // `h` is the last node, the stub takes its place.
+            next = h->next.load(std::memory_order_acquire);
+            if (next) {
+                head = next;
+                return h;
+            }
+            return nullptr;
+        }
+
+        bool empty() const noexcept
+        {
+            return head == &stub && tail.load(std::memory_order_seq_cst) == &stub;
+        }
+    };
+
+    /// <summary>
+    /// Wakes one waiting consumer thread: an eventfd on Linux (it can also be polled through `native_handle()`),
+    /// a condition variable elsewhere. Signals sent while nobody waits make the next `wait` return immediately.
+    /// </summary>
+    class wakeup
+    {
+#if defined(__linux__)
+        int fd;
+
+    public:
+        wakeup()
+            : fd(eventfd(0, EFD_CLOEXEC))
+        {}
+
+        ~wakeup()
+        {
+            close(fd);
+        }
+
+        void signal() noexcept
+        {
+            uint64_t one = 1;
+            while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR)
+            {}
+        }
+
+        void wait() noexcept
+        {
+            uint64_t count;
+            while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR)
+            {}
+        }
+
+        int native_handle() const noexcept
+        {
+            return fd;
+        }
+#else
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool signalled = false;
+
+    public:
+        wakeup() = default;
+
+        void signal()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                signalled = true;
+            }
+            cv.notify_one();
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return signalled; });
+            signalled = false;
+        }
+#endif
+
+        wakeup(const wakeup&) = delete;
+        void operator= (const wakeup&) = delete;
+    };
+}
+
+#endif  // _L_ASYNC_MPSC_H_
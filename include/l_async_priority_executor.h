@@ -0,0 +1,241 @@
+#ifndef _L_ASYNC_PRIORITY_EXECUTOR_H_
+#define _L_ASYNC_PRIORITY_EXECUTOR_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "l_async.h"
+#include "l_async_timer.h"
+
+namespace l_async
+{
+    enum class priority : unsigned char
+    {
+        background,
+        normal,
+        high,
+    };
+
+    /// <summary>
+    /// Single-threaded executor, that runs tasks of higher priority classes first
+    /// and, within a class, tasks with earlier deadlines first; tasks without deadline run in FIFO order after them.
+    /// Each task runs with the priority and deadline it was scheduled with, and `schedule(task)` without explicit ones inherits them,
+    /// so continuations of a `loop` or `slot` started at high priority stay at high priority.
+    /// Delayed tasks (`after`) wait in a timer wheel, `execute` sleeps while only timers are pending.
+    /// </summary>
+    class priority_executor
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+        using timer_id = timer_wheel::timer_id;
+        static constexpr clock::time_point no_deadline = clock::time_point::max();
+
+        // Priority and deadline inherited by tasks scheduled from the current thread.
+        struct context
+        {
+            l_async::priority priority = l_async::priority::normal;
+            clock::time_point deadline = no_deadline;
+        };
+
+        // Sets the ambient priority and deadline of the current thread (e.g. for a request handler started outside of tasks).
+        class scope
+        {
+            context saved;
+
+        public:
+            explicit scope(l_async::priority p, clock::time_point deadline = no_deadline)
+                : saved(current())
+            {
+                current() = { p, deadline };
+            }
+
+            scope(const scope&) = delete;
+            void operator= (const scope&) = delete;
+
+            ~scope()
+            {
+                current() = saved;
+            }
+        };
+
+    private:
+        static constexpr size_t classes = size_t(priority::high) + 1;
+
+        struct timed_task
+        {
+            clock::time_point deadline;
+            uint64_t seq;
+            unique_function<void()> fn;
+        };
+
+        struct later
+        {
+            bool operator() (const timed_task& a, const timed_task& b) const
+            {
+                return a.deadline != b.deadline ? a.deadline > b.deadline : a.seq > b.seq;
+            }
+        };
+
+        struct queue
+        {
+            std::vector<timed_task> timed;  // Heap ordered by `later`.
+            std::deque<unique_function<void()>> fifo;
+        };
+
+        queue queues[classes];
+        timer_wheel timers;
+        uint64_t next_seq = 0;
+        size_t max_dispatch_depth;
+        size_t dispatch_depth = 0;
+        bool executing = false;
+
+        static context& current()
+        {
+            static thread_local context c;
+            return c;
+        }
+
+        // Takes the next task into `fn`, returns its priority class.
+        size_t take(unique_function<void()>& fn, clock::time_point& deadline)
+        {
+            for (size_t c = classes; c-- > 0;) {
+                auto& q = queues[c];
+                if (!q.timed.empty()) {
+                    std::pop_heap(q.timed.begin(), q.timed.end(), later());
+                    fn = std::move(q.timed.back().fn);
+                    deadline = q.timed.back().deadline;
+                    q.timed.pop_back();
+                    return c;
+                }
+                if (!q.fifo.empty()) {
+                    fn = std::move(q.fifo.front());
+                    deadline = no_deadline;
+                    q.fifo.pop_front();
+                    return c;
+                }
+            }
+            return classes;
+        }
+
+    public:
+        /// <summary>
+        /// `max_dispatch_depth` limits nesting of tasks run inline by `dispatch`, `timer_tick` is the resolution of `after`.
+        /// </summary>
+        explicit priority_executor(size_t max_dispatch_depth = 16, clock::duration timer_tick = std::chrono::milliseconds(1))
+            : timers(timer_tick)
+            , max_dispatch_depth(max_dispatch_depth)
+        {}
+
+        priority_executor(const priority_executor&) = delete;
+        void operator= (const priority_executor&) = delete;
+
+        /// <summary>
+        /// Schedules a task with the priority and deadline of the task (or `scope`) it is called from.
+        /// </summary>
+        void schedule(unique_function<void()> task)
+        {
+            const context& c = current();
+            schedule(std::move(task), c.priority, c.deadline);
+        }
+
+        /// <summary>
+        /// Schedules a task with the given priority and optional deadline.
+        /// </summary>
+        void schedule(unique_function<void()> task, l_async::priority p, clock::time_point deadline = no_deadline)
+        {
+            auto& q = queues[size_t(p)];
+            if (deadline == no_deadline) {
+                q.fifo.push_back(std::move(task));
+            } else {
+                q.timed.push_back({ deadline, next_seq++, std::move(task) });
+                std::push_heap(q.timed.begin(), q.timed.end(), later());
+            }
+        }
+
+        /// <summary>
+        /// Runs the task right away (with the current priority and deadline) if called from a task of this executor
+        /// and the nesting budget allows, otherwise schedules it.
+        /// </summary>
+        void dispatch(unique_function<void()> task)
+        {
+            if (!executing || !detail::run_inline(dispatch_depth, max_dispatch_depth, task))
+                schedule(std::move(task));
+        }
+
+        /// <summary>
+        /// Schedules the task after the `delay` (rounded up to the timer tick), with the priority and deadline of the calling task.
+        /// </summary>
+        timer_id after(clock::duration delay, unique_function<void()> task)
+        {
+            return timers.at(clock::now() + delay, [this, task = std::move(task), c = current()]() mutable {
+                schedule(std::move(task), c.priority, c.deadline);
+            });
+        }
+
+        /// <summary>
+        /// Cancels a task of `after`, returns false if it has already been scheduled or cancelled.
+        /// </summary>
+        bool cancel(timer_id id)
+        {
+            return timers.cancel(id);
+        }
+
+        /// <summary>
+        /// Executes tasks in priority order until there are none, including tasks scheduled from them and delayed ones.
+        /// </summary>
+        void execute()
+        {
+            unique_function<void()> fn;
+            clock::time_point deadline;
+            executing = true;
+            for (;;) {
+                for (size_t c, n = 0; (c = take(fn, deadline)) < classes; n++) {
+                    scope s(l_async::priority(c), deadline);
+                    fn();
+                    fn = nullptr;
+                    if (n % 64 == 63 && !timers.empty())
+                        timers.advance(clock::now());  // Due timers compete with long runs of tasks.
+                }
+                if (timers.empty())
+                    break;
+                timers.advance(clock::now());
+                if (size() == 0)
+                    std::this_thread::sleep_until(*timers.next_expiry());
+            }
+            executing = false;
+        }
+
+        /// <summary>
+        /// Number of tasks waiting for execution, not counting pending `after` timers.
+        /// </summary>
+        size_t size() const
+        {
+            size_t n = 0;
+            for (auto& q : queues)
+                n += q.timed.size() + q.fifo.size();
+            return n;
+        }
+
+        /// <summary>
+        /// Priority of the running task (or of the current `scope`).
+        /// </summary>
+        static l_async::priority current_priority()
+        {
+            return current().priority;
+        }
+
+        /// <summary>
+        /// Deadline of the running task (or of the current `scope`).
+        /// </summary>
+        static clock::time_point current_deadline()
+        {
+            return current().deadline;
+        }
+    };
+}
+
+#endif  // _L_ASYNC_PRIORITY_EXECUTOR_H_
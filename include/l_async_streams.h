@@ -0,0 +1,668 @@
+#ifndef _L_ASYNC_STREAMS_H_
+#define _L_ASYNC_STREAMS_H_
+
+// Composable operators over pull streams.
+// A stream is any object called as `stream(callback)` to request one item, which calls `callback(optional<T>)`,
+// `nullopt` ends the stream (and is returned for all later requests). `slot<optional<T>>` and `channel<optional<T>, N>` are streams.
+//
+//     auto pipeline = streams::iterate(v.begin(), v.end())
+//         | streams::map([](int x) { return x * x; })
+//         | streams::filter([](int x) { return x % 3; })
+//         | streams::take(10);
+//
+// Adjacent synchronous stages (`map`, `filter`, `take`, `buffer`) are fused by `|` at compile time into one stage,
+// that has one heap block and one type-erased callback per pipeline segment, not per stage.
+// `merge`, `zip` and `prefetch` are asynchronous boundaries.
+// Streams are single-threaded, like `slot`.
+
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "l_async.h"
+
+namespace l_async
+{
+    namespace streams
+    {
+        // Item type of a stream: `value_type` member, or `T` of `slot<optional<T>>`, `channel<optional<T>, N>`
+        // and `std::function<void(function<void(optional<T>)>)>`.
+        template<typename S, typename = void>
+        struct stream_traits
+        {};
+
+        template<typename S>
+        struct stream_traits<S, std::void_t<typename S::value_type>>
+        {
+            using value_type = typename S::value_type;
+        };
+
+        template<typename T, typename Policy>
+        struct stream_traits<slot<std::optional<T>, Policy>>
+        {
+            using value_type = T;
+        };
+
+        template<typename T, size_t N>
+        struct stream_traits<channel<std::optional<T>, N>>
+        {
+            using value_type = T;
+        };
+
+        template<typename T>
+        struct stream_traits<std::function<void(std::function<void(std::optional<T>)>)>>
+        {
+            using value_type = T;
+        };
+
+        template<typename T>
+        struct stream_traits<std::function<void(unique_function<void(std::optional<T>)>)>>
+        {
+            using value_type = T;
+        };
+
+        template<typename S>
+        using value_t = typename stream_traits<std::decay_t<S>>::value_type;
+
+        // Gives any callable stream (e.g. a lambda) its item type.
+        template<typename T, typename S>
+        class typed
+        {
+            S s;
+
+        public:
+            using value_type = T;
+
+            explicit typed(S s)
+                : s(std::move(s))
+            {}
+
+            template<typename Callback>
+            void operator() (Callback&& callback)
+            {
+                s(std::forward<Callback>(callback));
+            }
+        };
+
+        template<typename T, typename S>
+        typed<T, S> as_stream(S s)
+        {
+            return typed<T, S>(std::move(s));
+        }
+
+        // Synchronous stream of `[begin, end)` items, the container must outlive the stream.
+        template<typename Iter>
+        class iterator_stream
+        {
+            Iter i;
+            Iter end;
+
+        public:
+            using value_type = std::decay_t<decltype(*std::declval<Iter>())>;
+
+            iterator_stream(Iter begin, Iter end)
+                : i(begin)
+                , end(end)
+            {}
+
+            template<typename Callback>
+            void operator() (Callback&& callback)
+            {
+                if (i == end) {
+                    callback(std::optional<value_type>());
+                } else {
+                    std::optional<value_type> v(*i);
+                    ++i;
+                    callback(std::move(v));
+                }
+            }
+        };
+
+        template<typename Iter>
+        iterator_stream<Iter> iterate(Iter begin, Iter end)
+        {
+            return iterator_stream<Iter>(begin, end);
+        }
+
+        // Synchronous stages. Each one is called as `op(item, next)` for an upstream item and forwards zero or one item to `next`,
+        // it returns false if the stream has to end after this item; `finish(next)` flushes held items when the upstream ends.
+        namespace detail
+        {
+            template<typename F>
+            struct map_op
+            {
+                F f;
+
+                template<typename T>
+                using result_t = std::decay_t<std::invoke_result_t<F&, T&&>>;
+
+                bool exhausted() const { return false; }
+
+                template<typename T, typename Next>
+                bool operator() (T&& v, Next& next)
+                {
+                    return next(f(std::forward<T>(v)));
+                }
+
+                template<typename Next>
+                void finish(Next&) {}
+            };
+
+            template<typename P>
+            struct filter_op
+            {
+                P p;
+
+                template<typename T>
+                using result_t = T;
+
+                bool exhausted() const { return false; }
+
+                template<typename T, typename Next>
+                bool operator() (T&& v, Next& next)
+                {
+                    return p(std::as_const(v)) ? next(std::forward<T>(v)) : true;
+                }
+
+                template<typename Next>
+                void finish(Next&) {}
+            };
+
+            struct take_op
+            {
+                size_t n;
+
+                template<typename T>
+                using result_t = T;
+
+                bool exhausted() const { return n == 0; }
+
+                template<typename T, typename Next>
+                bool operator() (T&& v, Next& next)
+                {
+                    n--;
+                    bool more = next(std::forward<T>(v));
+                    return more && n > 0;
+                }
+
+                template<typename Next>
+                void finish(Next&) {}
+            };
+
+            struct buffer_spec
+            {
+                size_t n;
+            };
+
+            template<typename T>
+            struct buffer_op
+            {
+                size_t n;
+                std::vector<T> batch;
+
+                template<typename>
+                using result_t = std::vector<T>;
+
+                bool exhausted() const { return false; }
+
+                template<typename U, typename Next>
+                bool operator() (U&& v, Next& next)
+                {
+                    batch.push_back(std::forward<U>(v));
+                    if (batch.size() < n)
+                        return true;
+                    std::vector<T> full(std::move(batch));
+                    batch.clear();
+                    batch.reserve(n);
+                    return next(std::move(full));
+                }
+
+                template<typename Next>
+                void finish(Next& next)
+                {
+                    if (!batch.empty())
+                        next(std::move(batch));
+                    batch.clear();
+                }
+            };
+
+            // Stage of the given input item type.
+            template<typename Op, typename T>
+            struct bind
+            {
+                using type = Op;
+                static Op make(Op op) { return op; }
+            };
+
+            template<typename T>
+            struct bind<buffer_spec, T>
+            {
+                using type = buffer_op<T>;
+                static type make(buffer_spec spec) { return { spec.n, {} }; }
+            };
+
+            template<typename T, typename... Ops>
+            struct chain_output
+            {
+                using type = T;
+            };
+
+            template<typename T, typename Op, typename... Ops>
+            struct chain_output<T, Op, Ops...>
+            {
+                using type = typename chain_output<typename Op::template result_t<T>, Ops...>::type;
+            };
+        }
+
+        template<typename Op>
+        struct stage
+        {
+            Op op;
+        };
+
+        // Transforms each item with `f(item)`.
+        template<typename F>
+        stage<detail::map_op<F>> map(F f)
+        {
+            return { { std::move(f) } };
+        }
+
+        // Passes items, for which `p(item)` is true.
+        template<typename P>
+        stage<detail::filter_op<P>> filter(P p)
+        {
+            return { { std::move(p) } };
+        }
+
+        // Ends the stream after `n` items, without requesting more from upstream.
+        inline stage<detail::take_op> take(size_t n)
+        {
+            return { { n } };
+        }
+
+        // Groups items into `vector`s of `n` items, the last one may be shorter.
+        inline stage<detail::buffer_spec> buffer(size_t n)
+        {
+            assert(n > 0);
+            return { { n } };
+        }
+
+        // Fused chain of synchronous stages over an upstream stream.
+        template<typename Upstream, typename... Ops>
+        class fused
+        {
+            template<typename U, typename... O>
+            friend class fused;
+
+            using input_t = value_t<Upstream>;
+
+        public:
+            using value_type = typename detail::chain_output<input_t, Ops...>::type;
+
+        private:
+            struct state
+            {
+                single_threaded::counter refs;
+                Upstream upstream;
+                std::tuple<Ops...> ops;
+                unique_function<void(std::optional<value_type>)> waiting;
+                std::vector<value_type> ready;  // Items produced by the chain but not yet requested.
+                size_t ready_head = 0;
+                bool ended = false;
+                bool pulling = false;
+                bool again = false;
+
+                state(Upstream upstream, std::tuple<Ops...> ops)
+                    : upstream(std::move(upstream))
+                    , ops(std::move(ops))
+                {}
+
+                // Feeds an item to the I-th stage, the last stage stores it to `ready`.
+                template<size_t I, typename T>
+                bool apply(T&& v)
+                {
+                    if constexpr (I == sizeof...(Ops)) {
+                        ready.emplace_back(std::forward<T>(v));
+                        return true;
+                    } else {
+                        auto next = next_stage<I + 1>{ *this };
+                        return std::get<I>(ops)(std::forward<T>(v), next);
+                    }
+                }
+
+                template<size_t I>
+                struct next_stage
+                {
+                    state& self;
+
+                    template<typename T>
+                    bool operator() (T&& v)
+                    {
+                        return self.template apply<I>(std::forward<T>(v));
+                    }
+                };
+
+                template<size_t I>
+                void finish()
+                {
+                    if constexpr (I < sizeof...(Ops)) {
+                        auto next = next_stage<I + 1>{ *this };
+                        std::get<I>(ops).finish(next);
+                        finish<I + 1>();
+                    }
+                }
+
+                bool exhausted() const
+                {
+                    return std::apply([](const auto&... op) { return (op.exhausted() || ...); }, ops);
+                }
+
+                void deliver(std::optional<value_type> v)
+                {
+                    unique_function<void(std::optional<value_type>)> temp(std::move(waiting));
+                    temp(std::move(v));
+                }
+
+                bool deliver_ready()
+                {
+                    if (ready_head == ready.size())
+                        return false;
+                    std::optional<value_type> v(std::move(ready[ready_head++]));
+                    if (ready_head == ready.size()) {
+                        ready.clear();
+                        ready_head = 0;
+                    }
+                    deliver(std::move(v));
+                    return true;
+                }
+
+                void on_item(std::optional<input_t> v, const l_async::detail::ref_ptr<state>& self)
+                {
+                    if (!v) {
+                        ended = true;
+                        finish<0>();
+                    } else if (!apply<0>(std::move(*v))) {
+                        ended = true;
+                    }
+                    if (deliver_ready())
+                        return;
+                    if (ended)
+                        deliver(std::nullopt);
+                    else
+                        pull(self);  // The item is filtered out.
+                }
+
+                // Requests upstream items till one passes the chain, synchronous responses are handled by iterations, not recursion.
+                void pull(const l_async::detail::ref_ptr<state>& self)
+                {
+                    if (pulling) {
+                        again = true;
+                        return;
+                    }
+                    pulling = true;
+                    do {
+                        again = false;
+                        upstream([self](std::optional<input_t> v) {
+                            self->on_item(std::move(v), self);
+                        });
+                    } while (again && waiting);
+                    pulling = false;
+                }
+
+                void request(unique_function<void(std::optional<value_type>)> callback, const l_async::detail::ref_ptr<state>& self)
+                {
+                    waiting = std::move(callback);
+                    if (deliver_ready())
+                        return;
+                    if (ended || exhausted()) {
+                        ended = true;
+                        deliver(std::nullopt);
+                        return;
+                    }
+                    pull(self);
+                }
+            };
+
+            l_async::detail::ref_ptr<state> ptr;
+
+        public:
+            fused(Upstream upstream, std::tuple<Ops...> ops)
+                : ptr(new state(std::move(upstream), std::move(ops)))
+            {}
+
+            template<typename Callback>
+            void operator() (Callback&& callback) const
+            {
+                ptr->request(std::forward<Callback>(callback), ptr);
+            }
+
+            // Appends a stage to a chain that has not been requested yet.
+            template<typename Op>
+            fused<Upstream, Ops..., typename detail::bind<Op, value_type>::type> append(Op op) &&
+            {
+                return fused<Upstream, Ops..., typename detail::bind<Op, value_type>::type>(
+                    std::move(ptr->upstream),
+                    std::tuple_cat(std::move(ptr->ops), std::make_tuple(detail::bind<Op, value_type>::make(std::move(op)))));
+            }
+        };
+
+        template<typename S>
+        struct is_fused : std::false_type {};
+
+        template<typename U, typename... Ops>
+        struct is_fused<fused<U, Ops...>> : std::true_type {};
+
+        // Starts a fused chain over any stream, or wraps a named (lvalue) chain as an upstream.
+        template<typename S, typename Op, typename = std::enable_if_t<!is_fused<std::decay_t<S>>::value || std::is_lvalue_reference_v<S>>>
+        auto operator| (S&& s, stage<Op> st)
+        {
+            using bound = detail::bind<Op, value_t<S>>;
+            return fused<std::decay_t<S>, typename bound::type>(std::forward<S>(s), std::make_tuple(bound::make(std::move(st.op))));
+        }
+
+        // Fuses the stage into a temporary chain.
+        template<typename U, typename... Ops, typename Op>
+        auto operator| (fused<U, Ops...>&& s, stage<Op> st)
+        {
+            return std::move(s).append(std::move(st.op));
+        }
+
+        // Items of both streams in the order of arrival, ends when both streams end.
+        template<typename A, typename B>
+        class merged
+        {
+        public:
+            using value_type = value_t<A>;
+
+        private:
+            static_assert(std::is_same_v<value_type, value_t<B>>, "merged streams should have the same item type");
+
+            struct state
+            {
+                single_threaded::counter refs;
+                A a;
+                B b;
+                unique_function<void(std::optional<value_type>)> waiting;
+                std::optional<value_type> buffered[2];
+                bool requested[2] = { false, false };
+                bool ended[2] = { false, false };
+                int prefer = 0;
+                bool serving = false;
+
+                state(A a, B b)
+                    : a(std::move(a))
+                    , b(std::move(b))
+                {}
+
+                void request(int i, const l_async::detail::ref_ptr<state>& self)
+                {
+                    requested[i] = true;
+                    auto callback = [self, i](std::optional<value_type> v) {
+                        self->requested[i] = false;
+                        if (v)
+                            self->buffered[i] = std::move(v);
+                        else
+                            self->ended[i] = true;
+                        self->serve(self);
+                    };
+                    if (i == 0)
+                        a(std::move(callback));
+                    else
+                        b(std::move(callback));
+                }
+
+                void serve(const l_async::detail::ref_ptr<state>& self)
+                {
+                    if (serving)
+                        return;  // The loop below picks up synchronous arrivals.
+                    serving = true;
+                    while (waiting) {
+                        int i = buffered[prefer] ? prefer : buffered[1 - prefer] ? 1 - prefer : -1;
+                        if (i >= 0 || (ended[0] && ended[1])) {
+                            std::optional<value_type> v;
+                            if (i >= 0) {
+                                prefer = 1 - i;
+                                v = std::move(buffered[i]);
+                                buffered[i].reset();
+                            }
+                            unique_function<void(std::optional<value_type>)> temp(std::move(waiting));
+                            temp(std::move(v));
+                            continue;
+                        }
+                        bool requested_now = false;
+                        for (int side = 0; side < 2; side++) {
+                            if (!ended[side] && !requested[side] && !buffered[side]) {
+                                request(side, self);
+                                requested_now = true;
+                            }
+                        }
+                        if (!requested_now)
+                            break;  // Waits for arrivals.
+                    }
+                    serving = false;
+                }
+            };
+
+            l_async::detail::ref_ptr<state> ptr;
+
+        public:
+            merged(A a, B b)
+                : ptr(new state(std::move(a), std::move(b)))
+            {}
+
+            template<typename Callback>
+            void operator() (Callback&& callback) const
+            {
+                ptr->waiting = std::forward<Callback>(callback);
+                ptr->serve(ptr);
+            }
+        };
+
+        template<typename A, typename B>
+        merged<A, B> merge(A a, B b)
+        {
+            return merged<A, B>(std::move(a), std::move(b));
+        }
+
+        // Pairs of items requested from both streams in parallel, ends when either stream ends.
+        // Both streams receive move-only callbacks (`join` setters).
+        template<typename A, typename B>
+        class zipped
+        {
+            struct state
+            {
+                single_threaded::counter refs;
+                A a;
+                B b;
+
+                state(A a, B b)
+                    : a(std::move(a))
+                    , b(std::move(b))
+                {}
+            };
+
+            l_async::detail::ref_ptr<state> ptr;
+
+        public:
+            using value_type = std::pair<value_t<A>, value_t<B>>;
+
+            zipped(A a, B b)
+                : ptr(new state(std::move(a), std::move(b)))
+            {}
+
+            template<typename Callback>
+            void operator() (Callback&& callback) const
+            {
+                using first_t = std::optional<value_t<A>>;
+                using second_t = std::optional<value_t<B>>;
+                join<first_t, second_t> both([callback = std::forward<Callback>(callback)](first_t a, second_t b) mutable {
+                    callback(a && b
+                        ? std::optional<value_type>(std::in_place, std::move(*a), std::move(*b))
+                        : std::nullopt);
+                });
+                ptr->a(both.template get<0>());
+                ptr->b(both.template get<1>());
+            }
+        };
+
+        template<typename A, typename B>
+        zipped<A, B> zip(A a, B b)
+        {
+            return zipped<A, B>(std::move(a), std::move(b));
+        }
+
+        template<size_t N>
+        struct prefetch_stage
+        {};
+
+        // Requests up to `N` items ahead of the consumer into a `channel`.
+        template<size_t N>
+        prefetch_stage<N> prefetch()
+        {
+            return {};
+        }
+
+        template<typename S, size_t N>
+        channel<std::optional<value_t<S>>, N> operator| (S s, prefetch_stage<N>)
+        {
+            using item_t = std::optional<value_t<S>>;
+            channel<item_t, N> result;
+            loop producing([s = std::move(s), sink = result.get_provider(), ended = false](auto next) mutable {
+                sink.await([&, next] {
+                    if (ended) {
+                        sink(std::nullopt);  // Keeps answering `nullopt` after the end, as streams do.
+                        next();
+                        return;
+                    }
+                    s([&, next](item_t v) {
+                        ended = !v;
+                        sink(std::move(v));
+                        next();
+                    });
+                });
+            });
+            return result;
+        }
+
+        // Calls `body(item)` for each item and then `on_end()`; synchronous items are handled by loop iterations.
+        template<typename S, typename Body, typename OnEnd>
+        void for_each(S s, Body body, OnEnd on_end)
+        {
+            loop consuming([s = std::move(s), body = std::move(body), on_end = std::move(on_end)](auto next) mutable {
+                s([&, next](std::optional<value_t<S>> v) {
+                    if (!v) {
+                        on_end();
+                        return;
+                    }
+                    body(std::move(*v));
+                    next();
+                });
+            });
+        }
+    }
+}
+
+#endif  // _L_ASYNC_STREAMS_H_
@@ -0,0 +1,675 @@
+#ifndef _L_ASYNC_THREAD_POOL_H_
+#define _L_ASYNC_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cassert>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "l_async.h"
+#include "l_async_mpsc.h"
+
+namespace l_async
+{
+    /// <summary>
+    /// Chase-Lev work-stealing deque of pointers.
+    /// The owner thread pushes and pops at the bottom, any thread can steal from the top.
+    /// </summary>
+    template<typename T>
+    class work_stealing_deque
+    {
+        struct array
+        {
+            int64_t mask;
+            std::unique_ptr<std::atomic<T*>[]> items;
+
+            array(int64_t capacity)
+                : mask(capacity - 1)
+                , items(new std::atomic<T*>[size_t(capacity)])
+            {}
+
+            int64_t capacity() const { return mask + 1; }
+            T* get(int64_t i) const { return items[size_t(i & mask)].load(std::memory_order_relaxed); }
+            void put(int64_t i, T* v) { items[size_t(i & mask)].store(v, std::memory_order_relaxed); }
+        };
+
+        std::atomic<int64_t> top{ 0 };
+        std::atomic<int64_t> bottom{ 0 };
+        std::atomic<array*> items;
+        std::vector<std::unique_ptr<array>> retired;  // Stealers may still read the old arrays.
+
+        array* grow(array* a, int64_t t, int64_t b)
+        {
+            auto bigger = std::make_unique<array>(a->capacity() * 2);
+            for (int64_t i = t; i < b; i++)
+                bigger->put(i, a->get(i));
+            array* result = bigger.get();
+            retired.push_back(std::move(bigger));
+            items.store(result, std::memory_order_release);
+            return result;
+        }
+
+    public:
+        work_stealing_deque(int64_t capacity = 256)
+        {
+            assert((capacity & (capacity - 1)) == 0);
+            retired.emplace_back(std::make_unique<array>(capacity));
+            items.store(retired.back().get(), std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(const work_stealing_deque&) = delete;
+        void operator= (const work_stealing_deque&) = delete;
+
+        void push(T* v)
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            array* a = items.load(std::memory_order_relaxed);
+            if (b - t > a->capacity() - 1)
+                a = grow(a, t, b);
+            a->put(b, v);
+            bottom.store(b + 1, std::memory_order_release);
+        }
+
+        T* pop()
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            array* a = items.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_seq_cst);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T* v = a->get(b);
+            if (t == b) {
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    v = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return v;
+        }
+
+        T* steal()
+        {
+            int64_t t = top.load(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_seq_cst);
+            if (t >= b)
+                return nullptr;
+            T* v = items.load(std::memory_order_acquire)->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return v;
+        }
+    };
+
+    /// <summary>
+    /// Heap of small blocks for one owner thread, carved from 64 KiB chunks that the owner allocates and touches first,
+    /// so under the first-touch NUMA policy its memory lives on the owner's node.
+    /// Blocks are kept in free lists by 16-byte size classes; blocks freed by other threads go to lock-free per-class lists,
+    /// that the owner takes over when its own list is empty. Chunks are released with the heap.
+    /// </summary>
+    class local_heap
+    {
+    public:
+        static constexpr size_t chunk_size = 64 * 1024;
+        static constexpr size_t granularity = 16;
+        static constexpr size_t max_block = 512;
+
+    private:
+        static constexpr size_t classes = max_block / granularity;
+
+        struct free_block
+        {
+            free_block* next;
+        };
+
+        struct alignas(granularity) chunk_header
+        {
+            local_heap* owner;
+            chunk_header* prev;
+        };
+
+        free_block* free_lists[classes] = {};
+        std::atomic<free_block*> remote_lists[classes] = {};
+        chunk_header* chunks = nullptr;
+        char* current = nullptr;
+        char* end = nullptr;
+
+        static size_t class_of(size_t bytes)
+        {
+            return (bytes + granularity - 1) / granularity - 1;
+        }
+
+        void add_chunk()
+        {
+            void* memory = ::operator new(chunk_size, std::align_val_t(chunk_size));
+            std::memset(memory, 0, chunk_size);  // The first touch maps the pages on this thread's node.
+            chunks = new (memory) chunk_header{ this, chunks };
+            current = static_cast<char*>(memory) + sizeof(chunk_header);
+            end = static_cast<char*>(memory) + chunk_size;
+        }
+
+    public:
+        local_heap() = default;
+        local_heap(const local_heap&) = delete;
+        void operator= (const local_heap&) = delete;
+
+        ~local_heap()
+        {
+            while (chunks)
+                ::operator delete(std::exchange(chunks, chunks->prev), std::align_val_t(chunk_size));
+        }
+
+        static bool fits(size_t bytes, size_t align)
+        {
+            return bytes <= max_block && align <= granularity;
+        }
+
+        // The heap, whose chunk holds the block.
+        static local_heap* owner_of(void* p)
+        {
+            return reinterpret_cast<chunk_header*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(chunk_size - 1))->owner;
+        }
+
+        // Called by the owner thread only, `bytes` must fit.
+        void* allocate(size_t bytes)
+        {
+            size_t c = class_of(bytes);
+            if (!free_lists[c])
+                free_lists[c] = remote_lists[c].exchange(nullptr, std::memory_order_acquire);
+            if (free_block* b = free_lists[c]) {
+                free_lists[c] = b->next;
+                return b;
+            }
+            size_t size = (c + 1) * granularity;
+            if (size_t(end - current) < size)
+                add_chunk();
+            return std::exchange(current, current + size);
+        }
+
+        // Called by the owner thread only.
+        void free_local(void* p, size_t bytes) noexcept
+        {
+            size_t c = class_of(bytes);
+            free_lists[c] = new (p) free_block{ free_lists[c] };
+        }
+
+        // Called by any thread.
+        void free_remote(void* p, size_t bytes) noexcept
+        {
+            auto& list = remote_lists[class_of(bytes)];
+            auto b = new (p) free_block{ list.load(std::memory_order_relaxed) };
+            while (!list.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed))
+            {}
+        }
+    };
+
+    /// <summary>
+    /// Executes tasks on a pool of worker threads.
+    /// Each worker has its own work-stealing deque: tasks scheduled from a worker go to its deque,
+    /// tasks scheduled from other threads go to a shared queue, idle workers steal from random victims.
+    /// Tasks given to `schedule_on` a worker go to its inbox and are never stolen; workers can be pinned to CPUs
+    /// and have `local_heap`s for control blocks, see `context_allocator`.
+    /// </summary>
+    class thread_pool_executor
+    {
+        struct task
+        {
+            unique_function<void()> fn;
+            task* next_free = nullptr;
+            std::atomic<task*> next{ nullptr };  // link in a worker's inbox
+        };
+
+        // Per-thread freelist of task nodes: a node executed (or stolen and executed) by a thread
+        // is reused by the next `schedule` of this thread, so steady-state scheduling from workers allocates nothing.
+        class task_cache
+        {
+            static constexpr size_t max_cached = 1024;
+            task* head = nullptr;
+            size_t count = 0;
+
+        public:
+            ~task_cache()
+            {
+                while (head)
+                    delete std::exchange(head, head->next_free);
+            }
+
+            task* make(unique_function<void()>&& fn)
+            {
+                if (!head)
+                    return new task{ std::move(fn) };
+                task* t = std::exchange(head, head->next_free);
+                count--;
+                t->fn = std::move(fn);
+                return t;
+            }
+
+            void recycle(task* t)
+            {
+                t->fn = nullptr;
+                if (count == max_cached) {
+                    delete t;
+                } else {
+                    t->next_free = std::exchange(head, t);
+                    count++;
+                }
+            }
+        };
+
+        static task_cache& cache()
+        {
+            static thread_local task_cache c;
+            return c;
+        }
+
+        struct worker
+        {
+            work_stealing_deque<task> tasks;
+            mpsc_queue<task> inbox;
+            std::atomic<size_t> bound{ 0 };  // Tasks pushed to the inbox but not taken.
+            std::unique_ptr<local_heap> heap;  // Created by the worker thread.
+            uint64_t seed;
+            std::thread thread;
+
+            explicit worker(uint64_t seed)
+                : seed(seed)
+            {}
+        };
+
+        struct current_worker
+        {
+            thread_pool_executor* pool = nullptr;
+            size_t index = 0;
+            size_t dispatch_depth = 0;
+        };
+
+        static current_worker& current()
+        {
+            static thread_local current_worker w;
+            return w;
+        }
+
+        std::vector<std::unique_ptr<worker>> workers;
+        size_t max_dispatch_depth;
+        bool pin_workers;
+        std::mutex outside_heap_mutex;
+        local_heap outside_heap;  // Blocks allocated outside of workers.
+        std::mutex shared_mutex;
+        std::deque<task*> shared_tasks;
+
+        std::atomic<size_t> available{ 0 };  // Tasks queued but not taken by workers.
+        std::atomic<size_t> pending{ 0 };    // Tasks scheduled but not finished.
+        std::atomic<size_t> sleepers{ 0 };
+        std::atomic<bool> stopping{ false };
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+        std::mutex idle_mutex;
+        std::condition_variable idle;
+
+        task* take_shared()
+        {
+            std::lock_guard<std::mutex> lock(shared_mutex);
+            if (shared_tasks.empty())
+                return nullptr;
+            task* t = shared_tasks.front();
+            shared_tasks.pop_front();
+            return t;
+        }
+
+        task* steal(worker& self)
+        {
+            self.seed ^= self.seed << 13;
+            self.seed ^= self.seed >> 7;
+            self.seed ^= self.seed << 17;
+            size_t n = workers.size();
+            for (size_t i = 0, victim = size_t(self.seed % n); i < n; i++, victim = (victim + 1) % n) {
+                if (workers[victim].get() != &self) {
+                    if (task* t = workers[victim]->tasks.steal())
+                        return t;
+                }
+            }
+            return nullptr;
+        }
+
+        task* take_bound(worker& self)
+        {
+            if (self.bound.load(std::memory_order_acquire) == 0)
+                return nullptr;
+            task* t = self.inbox.pop();
+            if (t)
+                self.bound.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+
+        task* find_task(worker& self)
+        {
+            if (task* t = self.tasks.pop()) {
+                available.fetch_sub(1, std::memory_order_relaxed);
+                return t;
+            }
+            if (task* t = take_bound(self))
+                return t;
+            task* t = take_shared();
+            if (!t)
+                t = steal(self);
+            if (t)
+                available.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+
+        void run(task* t)
+        {
+            t->fn();
+            cache().recycle(t);
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                idle.notify_all();
+            }
+        }
+
+        // Pins the calling thread to the `index`-th CPU (modulo their number) of those it may run on.
+        static void pin_current_thread(size_t index)
+        {
+#if defined(__linux__)
+            cpu_set_t allowed;
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+                return;
+            size_t k = index % size_t(CPU_COUNT(&allowed));
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &allowed) && k-- == 0) {
+                    cpu_set_t one;
+                    CPU_ZERO(&one);
+                    CPU_SET(cpu, &one);
+                    pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+                    return;
+                }
+            }
+#else
+            (void)index;
+#endif
+        }
+
+        void work(size_t index)
+        {
+            worker& self = *workers[index];
+            if (pin_workers)
+                pin_current_thread(index);
+            self.heap.reset(new local_heap());  // after pinning, so its chunks are first touched on the worker's node
+            current() = { this, index };
+            while (!stopping.load(std::memory_order_acquire)) {
+                if (task* t = find_task(self)) {
+                    run(t);
+                } else if (available.load(std::memory_order_seq_cst) > 0 || self.bound.load(std::memory_order_seq_cst) > 0) {
+                    std::this_thread::yield();  // A task is being pushed or taken by others.
+                } else {
+                    std::unique_lock<std::mutex> lock(sleep_mutex);
+                    sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    wake.wait(lock, [&] {
+                        return stopping.load(std::memory_order_acquire) ||
+                            available.load(std::memory_order_seq_cst) > 0 ||
+                            self.bound.load(std::memory_order_seq_cst) > 0;
+                    });
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            current() = {};
+        }
+
+        void* allocate_block(size_t bytes)
+        {
+            auto& w = current();
+            if (w.pool == this)
+                return workers[w.index]->heap->allocate(bytes);
+            std::lock_guard<std::mutex> lock(outside_heap_mutex);
+            return outside_heap.allocate(bytes);
+        }
+
+        void free_block(void* p, size_t bytes) noexcept
+        {
+            local_heap* owner = local_heap::owner_of(p);
+            auto& w = current();
+            if (w.pool == this && owner == workers[w.index]->heap.get())
+                owner->free_local(p, bytes);
+            else
+                owner->free_remote(p, bytes);
+        }
+
+    public:
+        /// <summary>
+        /// Starts the given number of worker threads.
+        /// `max_dispatch_depth` limits nesting of tasks run inline by `dispatch`.
+        /// With `pin_workers` the `i`-th worker runs only on the `i`-th CPU available to the process (Linux only).
+        /// </summary>
+        explicit thread_pool_executor(size_t threads = std::thread::hardware_concurrency(), size_t max_dispatch_depth = 16, bool pin_workers = false)
+            : max_dispatch_depth(max_dispatch_depth)
+            , pin_workers(pin_workers)
+        {
+            if (threads == 0)
+                threads = 1;
+            for (size_t i = 0; i < threads; i++)
+                workers.emplace_back(new worker(0x9E3779B97F4A7C15ull * (i + 1)));
+            for (size_t i = 0; i < threads; i++)
+                workers[i]->thread = std::thread([this, i] { work(i); });
+        }
+
+        thread_pool_executor(const thread_pool_executor&) = delete;
+        void operator= (const thread_pool_executor&) = delete;
+
+        /// <summary>
+        /// Stops workers, tasks that have not been started are destroyed without execution.
+        /// </summary>
+        ~thread_pool_executor()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                stopping.store(true, std::memory_order_release);
+            }
+            wake.notify_all();
+            for (auto& w : workers)
+                w->thread.join();
+            for (auto& w : workers) {
+                while (task* t = w->tasks.pop())
+                    delete t;
+                while (task* t = w->inbox.pop())
+                    delete t;
+            }
+            for (task* t : shared_tasks)
+                delete t;
+        }
+
+        /// <summary>
+        /// Schedules a task for execution on some worker thread.
+        /// Called from a worker of this pool, it puts the task into this worker's deque.
+        /// </summary>
+        void schedule(unique_function<void()> fn)
+        {
+            pending.fetch_add(1, std::memory_order_relaxed);
+            task* t = cache().make(std::move(fn));
+            available.fetch_add(1, std::memory_order_seq_cst);
+            auto& w = current();
+            if (w.pool == this) {
+                workers[w.index]->tasks.push(t);
+            } else {
+                std::lock_guard<std::mutex> lock(shared_mutex);
+                shared_tasks.push_back(t);
+            }
+            if (sleepers.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                wake.notify_one();
+            }
+        }
+
+        /// <summary>
+        /// Schedules a task for execution on the given worker, it is never stolen by others.
+        /// </summary>
+        void schedule_on(size_t worker_index, unique_function<void()> fn)
+        {
+            assert(worker_index < workers.size());
+            pending.fetch_add(1, std::memory_order_relaxed);
+            task* t = cache().make(std::move(fn));
+            worker& w = *workers[worker_index];
+            w.bound.fetch_add(1, std::memory_order_seq_cst);
+            w.inbox.push(t);
+            if (sleepers.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                wake.notify_all();  // Workers share the condition, the bound one has to be among the woken.
+            }
+        }
+
+        /// <summary>
+        /// Runs the task right away if called from a worker of this pool and the nesting budget allows,
+        /// otherwise schedules it.
+        /// </summary>
+        void dispatch(unique_function<void()> fn)
+        {
+            auto& w = current();
+            if (w.pool != this || !detail::run_inline(w.dispatch_depth, max_dispatch_depth, fn))
+                schedule(std::move(fn));
+        }
+
+        /// <summary>
+        /// Runs the task right away if called from the given worker and the nesting budget allows,
+        /// otherwise schedules it on that worker.
+        /// </summary>
+        void dispatch_on(size_t worker_index, unique_function<void()> fn)
+        {
+            auto& w = current();
+            if (w.pool != this || w.index != worker_index || !detail::run_inline(w.dispatch_depth, max_dispatch_depth, fn))
+                schedule_on(worker_index, std::move(fn));
+        }
+
+        /// <summary>
+        /// One worker of the pool as an executor, e.g. the home of a loop made with `bind_to`.
+        /// </summary>
+        class worker_executor
+        {
+            thread_pool_executor* pool;
+            size_t index;
+
+        public:
+            worker_executor(thread_pool_executor& pool, size_t index)
+                : pool(&pool)
+                , index(index)
+            {}
+
+            void schedule(unique_function<void()> fn) const
+            {
+                pool->schedule_on(index, std::move(fn));
+            }
+
+            void dispatch(unique_function<void()> fn) const
+            {
+                pool->dispatch_on(index, std::move(fn));
+            }
+
+            size_t worker_index() const
+            {
+                return index;
+            }
+        };
+
+        worker_executor worker_at(size_t worker_index)
+        {
+            assert(worker_index < workers.size());
+            return worker_executor(*this, worker_index);
+        }
+
+        /// <summary>
+        /// Allocator of control blocks (`loop`, `result`, `slot` or `channel` with `std::allocator_arg`) from the `local_heap`
+        /// of the allocating worker, blocks allocated outside of workers come from a shared heap.
+        /// Blocks can be freed on any thread, but all must be freed before the pool is destroyed.
+        /// </summary>
+        template<typename T>
+        class context_allocator
+        {
+            template<typename U>
+            friend class context_allocator;
+
+            thread_pool_executor* pool;
+
+        public:
+            using value_type = T;
+
+            context_allocator(thread_pool_executor& pool) noexcept
+                : pool(&pool)
+            {}
+
+            template<typename U>
+            context_allocator(const context_allocator<U>& src) noexcept
+                : pool(src.pool)
+            {}
+
+            T* allocate(size_t n)
+            {
+                if (!local_heap::fits(n * sizeof(T), alignof(T)))
+                    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+                return static_cast<T*>(pool->allocate_block(n * sizeof(T)));
+            }
+
+            void deallocate(T* p, size_t n) noexcept
+            {
+                if (!local_heap::fits(n * sizeof(T), alignof(T)))
+                    ::operator delete(p, std::align_val_t(alignof(T)));
+                else
+                    pool->free_block(p, n * sizeof(T));
+            }
+
+            template<typename U>
+            bool operator== (const context_allocator<U>& other) const noexcept
+            {
+                return pool == other.pool;
+            }
+
+            template<typename U>
+            bool operator!= (const context_allocator<U>& other) const noexcept
+            {
+                return pool != other.pool;
+            }
+        };
+
+        /// <summary>
+        /// Blocks the calling thread until all scheduled tasks and all tasks scheduled from them are executed.
+        /// Must not be called from the worker threads.
+        /// </summary>
+        void execute()
+        {
+            assert(current().pool != this);
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            idle.wait(lock, [&] { return pending.load(std::memory_order_acquire) == 0; });
+        }
+
+        /// <summary>
+        /// Number of worker threads.
+        /// </summary>
+        size_t size() const
+        {
+            return workers.size();
+        }
+
+        /// <summary>
+        /// Index of the worker running the calling thread, or `size()` if called outside of this pool.
+        /// </summary>
+        size_t current_worker_index() const
+        {
+            auto& w = current();
+            return w.pool == this ? w.index : workers.size();
+        }
+    };
+}
+
+#endif  // _L_ASYNC_THREAD_POOL_H_
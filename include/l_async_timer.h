@@ -0,0 +1,279 @@
+#ifndef _L_ASYNC_TIMER_H_
+#define _L_ASYNC_TIMER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "l_async.h"
+
+namespace l_async
+{
+    /// <summary>
+    /// Hierarchical timer wheel: 4 levels of 64 slots, each level covers 64 times longer span than the previous one.
+    /// Insertion and cancellation are O(1), timers are intrusive doubly-linked lists of pooled nodes;
+    /// a timer due in 64^k ticks is moved down one level once per 64^k ticks before it fires.
+    /// Timers are not synchronized, the wheel belongs to one thread (e.g. to an executor).
+    /// Time is passed explicitly to `advance`, so the wheel is usable with any clock and in tests.
+    /// </summary>
+    class timer_wheel
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // Handle of a pending timer, stays valid (and harmless to cancel) after the timer fires.
+        struct timer_id
+        {
+            uint32_t index = npos;
+            uint32_t generation = 0;
+        };
+
+    private:
+        static constexpr uint32_t npos = UINT32_MAX;
+        static constexpr unsigned slot_bits = 6;
+        static constexpr uint64_t slots = uint64_t(1) << slot_bits;
+        static constexpr unsigned levels = 4;
+
+        struct node
+        {
+            uint64_t expiry = 0;  // in ticks
+            uint32_t prev = npos;
+            uint32_t next = npos;
+            uint32_t generation = 0;
+            uint32_t* head = nullptr;  // slot list of a pending timer, null for free nodes
+            unique_function<void()> fn;
+        };
+
+        std::vector<node> nodes;
+        std::vector<uint32_t> free_nodes;
+        uint32_t heads[levels][slots];
+        clock::time_point origin;
+        clock::duration tick;
+        uint64_t current = 0;  // last processed tick
+        size_t pending = 0;
+
+        void link(uint32_t index)
+        {
+            node& n = nodes[index];
+            uint64_t delta = n.expiry > current ? n.expiry - current : 0;
+            uint64_t at = n.expiry > current ? n.expiry : current;
+            unsigned level = 0;
+            while (level + 1 < levels && delta >= uint64_t(1) << (slot_bits * (level + 1)))
+                level++;
+            if (delta >= uint64_t(1) << (slot_bits * levels))
+                at = current + (uint64_t(1) << (slot_bits * levels)) - 1;  // re-linked, when its top level slot comes up
+            uint32_t& head = heads[level][(at >> (slot_bits * level)) & (slots - 1)];
+            n.head = &head;
+            n.prev = npos;
+            n.next = head;
+            if (head != npos)
+                nodes[head].prev = index;
+            head = index;
+        }
+
+        void unlink(uint32_t index)
+        {
+            node& n = nodes[index];
+            if (n.prev != npos)
+                nodes[n.prev].next = n.next;
+            else
+                *n.head = n.next;
+            if (n.next != npos)
+                nodes[n.next].prev = n.prev;
+            n.head = nullptr;
+        }
+
+        void release(uint32_t index)
+        {
+            nodes[index].generation++;
+            free_nodes.push_back(index);
+        }
+
+        // Moves timers of the level's current slot to lower levels.
+        void cascade(unsigned level)
+        {
+            uint32_t& head = heads[level][(current >> (slot_bits * level)) & (slots - 1)];
+            uint32_t index = head;
+            head = npos;
+            while (index != npos) {
+                uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        void fire_due()
+        {
+            uint32_t& head = heads[0][current & (slots - 1)];
+            while (head != npos) {
+                uint32_t index = head;
+                unlink(index);
+                unique_function<void()> fn(std::move(nodes[index].fn));
+                release(index);
+                pending--;
+                fn();  // May add and cancel timers.
+            }
+        }
+
+        // The first tick after `current`, when a non-empty slot fires or cascades.
+        uint64_t next_tick() const
+        {
+            uint64_t result = UINT64_MAX;
+            for (unsigned level = 0; level < levels; level++) {
+                unsigned shift = slot_bits * level;
+                for (uint64_t i = 1; i <= slots; i++) {
+                    uint64_t t = ((current >> shift) + i) << shift;
+                    if (t >= result)
+                        break;
+                    if (heads[level][(t >> shift) & (slots - 1)] != npos) {
+                        result = t;
+                        break;
+                    }
+                }
+            }
+            return result;
+        }
+
+        // Ticks passed by `t`, rounded up for deadlines and down for the current time.
+        uint64_t ticks(clock::time_point t, bool round_up) const
+        {
+            if (t <= origin)
+                return 0;
+            return uint64_t((t - origin + (round_up ? tick - clock::duration(1) : clock::duration(0))) / tick);
+        }
+
+    public:
+        explicit timer_wheel(clock::duration tick = std::chrono::milliseconds(1), clock::time_point origin = clock::now())
+            : origin(origin)
+            , tick(tick)
+        {
+            for (auto& level : heads) {
+                for (auto& head : level)
+                    head = npos;
+            }
+        }
+
+        timer_wheel(const timer_wheel&) = delete;
+        void operator= (const timer_wheel&) = delete;
+
+        /// <summary>
+        /// Calls `fn` from the first `advance` reaching the `deadline` (rounded up to a tick).
+        /// </summary>
+        timer_id at(clock::time_point deadline, unique_function<void()> fn)
+        {
+            uint32_t index;
+            if (free_nodes.empty()) {
+                index = uint32_t(nodes.size());
+                nodes.emplace_back();
+            } else {
+                index = free_nodes.back();
+                free_nodes.pop_back();
+            }
+            node& n = nodes[index];
+            n.expiry = std::max(ticks(deadline, true), current + 1);
+            n.fn = std::move(fn);
+            link(index);
+            pending++;
+            return { index, n.generation };
+        }
+
+        /// <summary>
+        /// Cancels a pending timer, its `fn` is destroyed without a call.
+        /// Returns false if the timer has already fired or been cancelled.
+        /// </summary>
+        bool cancel(timer_id id)
+        {
+            if (id.index >= nodes.size() || nodes[id.index].generation != id.generation || !nodes[id.index].head)
+                return false;
+            unlink(id.index);
+            unique_function<void()> fn(std::move(nodes[id.index].fn));
+            release(id.index);
+            pending--;
+            return true;
+        }
+
+        /// <summary>
+        /// Fires all timers due by `now`, tick by tick.
+        /// </summary>
+        void advance(clock::time_point now)
+        {
+            uint64_t target = ticks(now, false);
+            while (current < target) {
+                uint64_t next = pending ? next_tick() : target + 1;
+                if (next > target) {
+                    current = target;  // Nothing fires or cascades in between.
+                    break;
+                }
+                current = next;
+                for (unsigned level = 1; level < levels && (current & ((uint64_t(1) << (slot_bits * level)) - 1)) == 0; level++)
+                    cascade(level);
+                fire_due();
+            }
+        }
+
+        /// <summary>
+        /// Lower bound of the earliest deadline (exact for timers due within 64 ticks), `nullopt` if there are no timers.
+        /// </summary>
+        std::optional<clock::time_point> next_expiry() const
+        {
+            if (pending == 0)
+                return std::nullopt;
+            return origin + tick * int64_t(next_tick());
+        }
+
+        size_t size() const
+        {
+            return pending;
+        }
+
+        bool empty() const
+        {
+            return pending == 0;
+        }
+    };
+
+    /// <summary>
+    /// Wraps a stream request `request(callback)` (e.g. a `slot` or `get_next_item`), so that `callback(fallback())` is called instead of the
+    /// response, if it does not come in `timeout`. `timers` is anything with `after(duration, fn) -> timer_id` and `cancel(timer_id)`,
+    /// like `priority_executor`; `fallback` is copied to each request. A request that timed out stays pending in the stream, so the next call
+    /// of the wrapper does not repeat it but waits for its response again (with a new timeout); a response nobody waits for is dropped.
+    /// Requests, responses and timers must run on one thread.
+    /// </summary>
+    template<typename Timers, typename Request, typename Fallback>
+    auto with_timeout(Timers& timers, Request request, timer_wheel::clock::duration timeout, Fallback fallback)
+    {
+        using value_t = decltype(fallback());
+        // One request of the stream, shared by the calls of the wrapper waiting for its response.
+        struct state
+        {
+            single_threaded::counter refs;
+            unique_function<void(value_t)> callback;
+            typename Timers::timer_id timer;
+            bool answered = false;
+        };
+        return [&timers, request = std::move(request), timeout, fallback = std::move(fallback), pending = detail::ref_ptr<state>()](auto callback) mutable {
+            bool repeat = !pending || pending->answered;
+            if (repeat)
+                pending = detail::ref_ptr<state>(new state());
+            detail::ref_ptr<state> s = pending;
+            assert(!s->callback);  // One call at a time, as with the stream itself.
+            s->callback = std::move(callback);
+            s->timer = timers.after(timeout, [s, fallback] {
+                if (auto cb = std::exchange(s->callback, nullptr))
+                    cb(fallback());
+            });
+            if (repeat) {
+                request([s, &timers](auto value) {
+                    s->answered = true;
+                    if (auto cb = std::exchange(s->callback, nullptr)) {
+                        timers.cancel(s->timer);
+                        cb(std::move(value));
+                    }
+                });
+            }
+        };
+    }
+}
+
+#endif  // _L_ASYNC_TIMER_H_
@@ -0,0 +1,231 @@
+#ifndef _L_ASYNC_TRACE_H_
+#define _L_ASYNC_TRACE_H_
+
+// Tracer for l_async primitives: lock-free counters and optional event capture exported as Chrome trace JSON
+// (open it in chrome://tracing or https://ui.perfetto.dev).
+//
+// Tracing is compiled in only when `L_ASYNC_TRACING` is defined for all translation units of the program
+// (e.g. `target_compile_definitions(app PRIVATE L_ASYNC_TRACING)`), then `l_async.h` includes this file
+// and passes all events to `l_async::trace::recorder`.
+// Otherwise primitives call `l_async::null_tracer`, whose empty hooks are optimized away.
+// A custom tracer having the same static hooks as `null_tracer` can be plugged with `L_ASYNC_TRACER=my_tracer`,
+// it must be declared before `l_async.h` is included.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace l_async
+{
+    namespace trace
+    {
+        class recorder
+        {
+        public:
+            struct counters
+            {
+                std::atomic<uint64_t> loops_created{ 0 };
+                std::atomic<uint64_t> loops_destroyed{ 0 };
+                std::atomic<uint64_t> loops_live{ 0 };
+                std::atomic<uint64_t> loops_peak{ 0 };
+                std::atomic<uint64_t> async_iterations{ 0 };
+                std::atomic<uint64_t> sync_restarts{ 0 };
+                std::atomic<uint64_t> results_fired{ 0 };
+                std::atomic<uint64_t> slot_awaits{ 0 };
+                std::atomic<uint64_t> slot_deliveries{ 0 };
+                // Control blocks of loops, results, slots and channels, and their bytes.
+                std::atomic<uint64_t> contexts_live{ 0 };
+                std::atomic<uint64_t> contexts_peak{ 0 };
+                std::atomic<uint64_t> context_bytes_live{ 0 };
+                std::atomic<uint64_t> context_bytes_peak{ 0 };
+            };
+
+        private:
+            struct event
+            {
+                const char* name;
+                char phase;  // 'b'/'e' - async span begin/end, 'i' - instant
+                const void* id;
+                uint64_t ts_ns;
+            };
+
+            struct thread_buffer
+            {
+                uint64_t tid;
+                std::vector<event> events;
+            };
+
+            struct registry
+            {
+                std::mutex mutex;
+                std::vector<std::unique_ptr<thread_buffer>> buffers;
+                std::atomic<bool> capturing{ false };
+                std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+            };
+
+            static registry& global()
+            {
+                static registry r;
+                return r;
+            }
+
+            static thread_buffer& local()
+            {
+                static thread_local thread_buffer* buffer = [] {
+                    auto& r = global();
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    r.buffers.emplace_back(new thread_buffer{ r.buffers.size() + 1, {} });
+                    return r.buffers.back().get();
+                }();
+                return *buffer;
+            }
+
+            static void record(const char* name, char phase, const void* id) noexcept
+            {
+                auto& r = global();
+                if (!r.capturing.load(std::memory_order_relaxed))
+                    return;
+                auto ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - r.origin).count();
+                try {
+                    local().events.push_back({ name, phase, id, uint64_t(ts) });
+                } catch (...) {
+                    // Tracing must not break the traced program.
+                }
+            }
+
+            static void bump(std::atomic<uint64_t>& c) noexcept
+            {
+                c.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            static void add_live(std::atomic<uint64_t>& live, std::atomic<uint64_t>& peak, uint64_t n) noexcept
+            {
+                uint64_t now = live.fetch_add(n, std::memory_order_relaxed) + n;
+                uint64_t p = peak.load(std::memory_order_relaxed);
+                while (p < now && !peak.compare_exchange_weak(p, now, std::memory_order_relaxed))
+                {}
+            }
+
+        public:
+            static counters& stats()
+            {
+                static counters c;
+                return c;
+            }
+
+            // Hooks called by primitives.
+
+            static void loop_created(const void* loop) noexcept
+            {
+                auto& s = stats();
+                bump(s.loops_created);
+                add_live(s.loops_live, s.loops_peak, 1);
+                record("loop", 'b', loop);
+            }
+
+            static void loop_iteration(const void* loop, bool sync_restart) noexcept
+            {
+                bump(sync_restart ? stats().sync_restarts : stats().async_iterations);
+                record(sync_restart ? "loop.sync_restart" : "loop.async_iteration", 'i', loop);
+            }
+
+            static void loop_destroyed(const void* loop) noexcept
+            {
+                bump(stats().loops_destroyed);
+                stats().loops_live.fetch_sub(1, std::memory_order_relaxed);
+                record("loop", 'e', loop);
+            }
+
+            static void result_fired(const void* result) noexcept
+            {
+                bump(stats().results_fired);
+                record("result.fire", 'i', result);
+            }
+
+            static void slot_awaited(const void* slot) noexcept
+            {
+                bump(stats().slot_awaits);
+                record("slot.wait", 'b', slot);
+            }
+
+            static void slot_delivered(const void* slot) noexcept
+            {
+                bump(stats().slot_deliveries);
+                record("slot.wait", 'e', slot);
+            }
+
+            static void context_allocated(const void*, size_t bytes) noexcept
+            {
+                auto& s = stats();
+                add_live(s.contexts_live, s.contexts_peak, 1);
+                add_live(s.context_bytes_live, s.context_bytes_peak, bytes);
+            }
+
+            static void context_freed(const void*, size_t bytes) noexcept
+            {
+                auto& s = stats();
+                s.contexts_live.fetch_sub(1, std::memory_order_relaxed);
+                s.context_bytes_live.fetch_sub(bytes, std::memory_order_relaxed);
+            }
+
+            // Control and export.
+
+            // Starts new peaks of loops, contexts and context bytes from their live values, e.g. before each measured run.
+            static void reset_peaks() noexcept
+            {
+                auto& s = stats();
+                s.loops_peak.store(s.loops_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                s.contexts_peak.store(s.contexts_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                s.context_bytes_peak.store(s.context_bytes_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+
+            static void start_capture() noexcept
+            {
+                global().capturing.store(true, std::memory_order_relaxed);
+            }
+
+            static void stop_capture() noexcept
+            {
+                global().capturing.store(false, std::memory_order_relaxed);
+            }
+
+            // Drops captured events. Must not be called while other threads record events.
+            static void clear_events()
+            {
+                auto& r = global();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                for (auto& b : r.buffers)
+                    b->events.clear();
+            }
+
+            // Writes captured events in Chrome trace event format. Must not be called while other threads record events.
+            static void write_chrome_trace(std::ostream& out)
+            {
+                auto& r = global();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                out << "{\"traceEvents\":[";
+                const char* separator = "\n";
+                for (auto& b : r.buffers) {
+                    for (auto& e : b->events) {
+                        out << separator
+                            << "{\"name\":\"" << e.name
+                            << "\",\"cat\":\"l_async\",\"ph\":\"" << e.phase
+                            << "\",\"ts\":" << e.ts_ns / 1000 << '.' << (e.ts_ns % 1000) / 100 << (e.ts_ns % 100) / 10 << e.ts_ns % 10
+                            << ",\"pid\":1,\"tid\":" << b->tid
+                            << ",\"id\":\"" << e.id << '"'
+                            << (e.phase == 'i' ? ",\"s\":\"t\"}" : "}");
+                        separator = ",\n";
+                    }
+                }
+                out << "\n]}\n";
+            }
+        };
+    }
+}
+
+#endif  // _L_ASYNC_TRACE_H_
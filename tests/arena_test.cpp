@@ -0,0 +1,123 @@
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <memory>
+using std::allocator_arg;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::loop;
+using l_async::result;
+using l_async::slot;
+using l_async::arena;
+using l_async::arena_allocator;
+
+namespace
+{
+    int live_blocks = 0;
+
+    template<typename T>
+    struct counting_allocator
+    {
+        using value_type = T;
+
+        counting_allocator() = default;
+
+        template<typename U>
+        counting_allocator(const counting_allocator<U>&) {}
+
+        T* allocate(size_t n)
+        {
+            live_blocks++;
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T* p, size_t n)
+        {
+            live_blocks--;
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        template<typename U>
+        bool operator== (const counting_allocator<U>&) const { return true; }
+
+        template<typename U>
+        bool operator!= (const counting_allocator<U>&) const { return false; }
+    };
+
+    TEST(LAsync, AllocatorTest)
+    {
+        executor ex;
+        int total = 0;
+        counting_allocator<char> alloc;
+        {
+            slot<optional<int>> numbers(allocator_arg, alloc);
+            loop producing(allocator_arg, alloc, [&, sink = numbers.get_provider(), i = 0](auto next) mutable {
+                sink.await([&, next] {
+                    ex.schedule([&, next] {
+                        sink(i < 10 ? optional<int>(i++) : nullopt);
+                        next();
+                    });
+                });
+            });
+            loop consuming(allocator_arg, alloc, [&, numbers, sum = result<int>(allocator_arg, alloc, [&](int v) { total = v; })](auto next) mutable {
+                numbers([&, next](auto v) {
+                    if (!v) return;
+                    *sum += *v;
+                    next();
+                });
+            });
+            ASSERT_EQ(live_blocks, 4);
+        }
+        ex.execute();
+        ASSERT_EQ(total, 45);
+        ASSERT_EQ(live_blocks, 0);
+    }
+
+    TEST(LAsync, ArenaTest)
+    {
+        executor ex;
+        int total = 0;
+        char buffer[256];
+        arena request_arena(buffer, sizeof(buffer));
+        {
+            arena_allocator<char> alloc(request_arena);
+            result<int> sum(allocator_arg, alloc, [&](int v) { total = v; });
+            for (int i = 1; i <= 10; i++) {
+                loop branch(allocator_arg, alloc, [&ex, sum, i, step = 0](auto next) mutable {
+                    *sum += i;
+                    if (++step < 3)
+                        ex.schedule(next);
+                });
+            }
+        }
+        ASSERT_LT(sizeof(buffer), request_arena.allocated()) << "arena must grow beyond initial buffer";
+        ex.execute();
+        ASSERT_EQ(total, 165);
+    }
+
+    TEST(LAsync, ArenaAlignmentTest)
+    {
+        auto aligned = [](void* p, size_t align) { return reinterpret_cast<uintptr_t>(p) % align == 0; };
+        {
+            arena a(16);  // Mixed alignments in one chunk, aligning steps past its end.
+            a.allocate(16, 4);
+            void* p = a.allocate(1, 8);
+            void* q = a.allocate(8, 8);
+            ASSERT_TRUE(aligned(p, 8) && aligned(q, 8));
+            static_cast<char*>(q)[7] = 1;
+        }
+        {
+            alignas(8) char buffer[8];
+            arena b(buffer + 1, 4);  // Unaligned caller buffer, too small for the aligned block.
+            void* p = b.allocate(8, 8);
+            ASSERT_TRUE(aligned(p, 8));
+            ASSERT_TRUE(p < buffer || p >= buffer + sizeof(buffer)) << "the block comes from a new chunk";
+            static_cast<char*>(p)[7] = 1;
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <vector>
+using std::vector;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::loop;
+using l_async::broadcast_slot;
+
+namespace
+{
+    using numbers_t = broadcast_slot<optional<int>>;
+
+    loop counter(numbers_t& numbers, int to, int& produced)
+    {
+        return loop([&produced, to, sink = numbers.get_provider(), i = 0](auto next) mutable {
+            sink.await([&, next] {
+                produced++;
+                sink(i < to ? optional<int>(i++) : nullopt);
+                next();
+            });
+        });
+    }
+
+    TEST(LAsync, BroadcastSlotTest)
+    {
+        executor ex;
+        int produced = 0, sum = 0;
+        vector<int> slow_received;
+        vector<const optional<int>*> fast_seen, slow_seen;
+        {
+            numbers_t numbers;
+            auto c = counter(numbers, 10, produced);
+            ASSERT_EQ(produced, 0) << "provider waits for subscribers";
+            auto fast_sub = numbers.subscribe();
+            auto slow_sub = numbers.subscribe();  // Both subscribe before the first request, so none misses values.
+            loop fast([&, sub = std::move(fast_sub)](auto next) mutable {
+                sub([&, next](numbers_t::value_ptr v) {
+                    fast_seen.push_back(v.get());
+                    if (!*v)
+                        return;
+                    sum += **v;
+                    next();
+                });
+            });
+            ASSERT_EQ(produced, 0) << "the slow subscriber has not requested yet";
+            loop slow([&, sub = std::move(slow_sub)](auto next) mutable {
+                sub([&, next](numbers_t::value_ptr v) {
+                    slow_seen.push_back(v.get());
+                    if (!*v)
+                        return;
+                    ASSERT_EQ(produced, int(slow_received.size()) + 1) << "the slowest subscriber sets the pace";
+                    slow_received.push_back(**v);
+                    ex.schedule(next);
+                });
+            });
+        }
+        ex.execute();
+        ASSERT_EQ(produced, 11);
+        ASSERT_EQ(sum, 45);
+        ASSERT_EQ(slow_received.size(), size_t(10));
+        ASSERT_TRUE(fast_seen == slow_seen) << "subscribers share one copy of each value";
+    }
+
+    TEST(LAsync, BroadcastUnsubscribeTest)
+    {
+        int produced = 0;
+        vector<int> received;
+        numbers_t numbers;
+        auto c = counter(numbers, 5, produced);
+        optional<numbers_t::subscriber> stalled(numbers.subscribe());
+        loop reading([&, sub = numbers.subscribe()](auto next) mutable {
+            sub([&, next](numbers_t::value_ptr v) {
+                if (*v) {
+                    received.push_back(**v);
+                    next();
+                }
+            });
+        });
+        ASSERT_EQ(produced, 0);
+        stalled.reset();  // The subscriber, that never requests, leaves and lets the provider go.
+        ASSERT_EQ(produced, 6);
+        ASSERT_TRUE(received == vector<int>({ 0, 1, 2, 3, 4 }));
+    }
+
+    TEST(LAsync, BroadcastSlowSubscriberTest)
+    {
+        executor ex;
+        numbers_t numbers;
+        auto sink = numbers.get_provider();
+        vector<int> fast_received, slow_received;
+        loop fast([&, sub = numbers.subscribe()](auto next) mutable {
+            sub([&, next](numbers_t::value_ptr v) {
+                if (*v) {
+                    fast_received.push_back(**v);
+                    next();
+                }
+            });
+        });
+        auto slow_sub = numbers.subscribe();  // Does not request until the executor runs.
+        for (int i = 0; i < 5; i++)
+            sink(i);  // Pushed without `await`, while the slow subscriber lags behind.
+        sink(nullopt);
+        ASSERT_TRUE(fast_received == vector<int>({ 0, 1, 2, 3, 4 }));
+        ex.schedule([&] {
+            loop slow([&, sub = std::move(slow_sub)](auto next) mutable {
+                sub([&, next](numbers_t::value_ptr v) {
+                    if (*v) {
+                        slow_received.push_back(**v);
+                        ex.schedule(next);
+                    }
+                });
+            });
+        });
+        ex.execute();
+        ASSERT_TRUE(slow_received == vector<int>({ 0, 1, 2, 3, 4 })) << "the backlog keeps values for the lagging subscriber";
+    }
+}
@@ -0,0 +1,130 @@
+#include <memory>
+using std::make_shared;
+using std::weak_ptr;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::loop;
+using l_async::result;
+using l_async::slot;
+using l_async::cancellation_source;
+using l_async::cancellation_token;
+using l_async::cancellation_subscription;
+
+namespace
+{
+    TEST(LAsync, CancelLoopTest)
+    {
+        executor ex;
+        cancellation_source cancel;
+        auto capture = make_shared<int>(0);
+        weak_ptr<int> watch = capture;
+        int iterations = 0;
+        loop counting(cancel.get_token(), [&, capture](auto next) {
+            if (++iterations == 3)
+                cancel.cancel();
+            ex.schedule(next);
+        });
+        capture.reset();
+        ex.execute();
+        ASSERT_EQ(iterations, 3);
+        ASSERT_TRUE(watch.expired());
+    }
+
+    TEST(LAsync, CancelSlotChainTest)
+    {
+        executor ex;
+        executor io;
+        cancellation_source cancel;
+        auto capture = make_shared<int>(0);
+        weak_ptr<int> watch = capture;
+        int requests = 0;
+        int received = 0;
+        {
+            slot<optional<int>> numbers(cancel.get_token());
+            loop producing([&, sink = numbers.get_provider()](auto next) {
+                sink.await([&, next] {
+                    io.schedule([&, next, v = requests++] {
+                        sink(v);
+                        next();
+                    });
+                });
+            });
+            loop consuming([&, numbers, capture](auto next) mutable {
+                numbers([&, next](optional<int> v) {
+                    if (v) {
+                        received++;
+                        ex.schedule(next);
+                    }
+                });
+            });
+        }
+        capture.reset();
+        io.execute();  // Delivers the first value.
+        ex.execute();  // The consumer requests the second one.
+        ASSERT_EQ(received, 1);
+        ASSERT_EQ(requests, 2);
+        cancel.cancel();
+        ASSERT_TRUE(watch.expired());  // The consumer is released without waiting for the provider.
+        io.execute();
+        ex.execute();
+        ASSERT_EQ(received, 1);
+        ASSERT_EQ(requests, 2);
+    }
+
+    TEST(LAsync, CancelResultTest)
+    {
+        executor ex;
+        cancellation_source cancel;
+        auto capture = make_shared<int>(0);
+        weak_ptr<int> watch = capture;
+        bool called = false;
+        {
+            result<int> sum(cancel.get_token(), [&, capture](int) { called = true; });
+            ex.schedule([sum]() mutable { *sum += 1; });
+        }
+        capture.reset();
+        cancel.cancel();
+        ASSERT_TRUE(watch.expired());
+        ex.execute();
+        ASSERT_FALSE(called);
+    }
+
+    TEST(LAsync, CancelledTokenTest)
+    {
+        cancellation_source cancel;
+        cancel.cancel();
+        cancel.cancel();
+        ASSERT_TRUE(cancel.get_token().is_cancelled());
+        ASSERT_FALSE(cancellation_token().is_cancelled());
+        int calls = 0;
+        cancellation_subscription late(cancel.get_token(), [&] { calls++; });
+        ASSERT_EQ(calls, 1);
+        int iterations = 0;
+        loop never(cancel.get_token(), [&](auto) { iterations++; });
+        ASSERT_EQ(iterations, 0);
+        bool called = false;
+        result<int>(cancel.get_token(), [&](int) { called = true; });
+        ASSERT_FALSE(called);
+    }
+
+    TEST(LAsync, CancelSubscriptionOrderTest)
+    {
+        cancellation_source cancel;
+        int calls = 0;
+        {
+            cancellation_subscription dropped(cancel.get_token(), [&] { calls += 100; });
+        }
+        cancellation_subscription first(cancel.get_token(), [&] { calls++; });
+        cancellation_subscription second(cancel.get_token(), [&] { calls++; });
+        cancel.cancel();
+        ASSERT_EQ(calls, 2);
+    }
+}
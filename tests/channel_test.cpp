@@ -0,0 +1,132 @@
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <vector>
+using std::vector;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::loop;
+using l_async::channel;
+
+namespace
+{
+    template<size_t N>
+    channel<optional<int>, N> counter(int to, int& produced)
+    {
+        channel<optional<int>, N> result;
+        loop producing([&produced, to, sink = result.get_provider(), i = 0](auto next) mutable {
+            sink.await([&, next] {
+                produced++;
+                sink(i < to ? optional<int>(i++) : nullopt);
+                next();
+            });
+        });
+        return result;
+    }
+
+    TEST(LAsync, ChannelBackpressureTest)
+    {
+        executor ex;
+        int produced = 0;
+        auto numbers = counter<4>(10, produced);
+        ASSERT_EQ(produced, 4) << "provider must run ahead till the buffer is full";
+        vector<int> received;
+        loop consuming([&, numbers](auto next) mutable {
+            numbers([&, next](auto v) {
+                if (!v) return;
+                ASSERT_LE(produced - int(received.size()), 5) << "only one item in flight above the buffer";
+                received.push_back(*v);
+                ex.schedule(next);
+            });
+        });
+        ex.execute();
+        ASSERT_EQ(received.size(), size_t(10));
+        for (int i = 0; i < 10; i++)
+            ASSERT_EQ(received[i], i);
+    }
+
+    TEST(LAsync, ChannelDrainTest)
+    {
+        executor ex;
+        channel<optional<int>, 8> numbers;
+        loop producing([&, sink = numbers.get_provider(), i = 0](auto next) mutable {
+            sink.await([&, next] {
+                ex.schedule([&, next] {
+                    sink(i < 20 ? optional<int>(i++) : nullopt);
+                    next();
+                });
+            });
+        });
+        int sum = 0, wakeups = 0;
+        bool done = false;
+        loop draining([&, numbers](auto next) mutable {
+            numbers.drain([&, next](auto items) {
+                wakeups++;
+                for (auto& v : items) {
+                    if (!v) {
+                        done = true;
+                        return;
+                    }
+                    sum += *v;
+                }
+                ex.schedule([&, next] {
+                    ex.schedule(next);
+                });
+            });
+        });
+        ex.execute();
+        ASSERT_TRUE(done);
+        ASSERT_EQ(sum, 190);
+        ASSERT_LT(wakeups, 21) << "items must be drained in batches";
+    }
+
+    TEST(LAsync, ChannelListenerReleasesTest)
+    {
+        optional<channel<int, 4>> numbers(std::in_place);
+        auto sink = numbers->get_provider();
+        sink(1);
+        sink(2);
+        int received = 0;
+        (*numbers)([&](int v) {
+            received += v;
+            numbers.reset();  // The last copy dies while the channel delivers the item.
+        });
+        ASSERT_EQ(received, 1);
+        sink(3);  // Ignored, the channel is gone.
+
+        numbers.emplace();
+        sink = numbers->get_provider();
+        sink(4);
+        numbers->drain([&](auto items) {
+            for (int v : items)
+                received += v;
+            numbers.reset();
+        });
+        ASSERT_EQ(received, 5);
+    }
+
+    TEST(LAsync, ChannelLargeDrainTest)
+    {
+        using numbers_t = channel<int, 200>;
+        numbers_t numbers;
+        auto sink = numbers.get_provider();
+        for (int i = 0; i < 150; i++)
+            sink(i);
+        vector<size_t> sizes;
+        int sum = 0;
+        for (int k = 0; k < 3; k++) {
+            numbers.drain([&](auto items) {
+                sizes.push_back(items.size());
+                for (int v : items)
+                    sum += v;
+            });
+        }
+        ASSERT_TRUE(sizes == vector<size_t>({ numbers_t::max_batch, numbers_t::max_batch, 150 - 2 * numbers_t::max_batch }));
+        ASSERT_EQ(sum, 149 * 150 / 2);
+    }
+}
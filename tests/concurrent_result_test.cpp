@@ -0,0 +1,65 @@
+#include <thread>
+using std::thread;
+
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
+#include <atomic>
+using std::atomic;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::concurrent_result;
+
+namespace
+{
+    TEST(LAsync, ConcurrentResultTest)
+    {
+        atomic<int> calls = 0;
+        long long total = 0;
+        {
+            concurrent_result<long long> result([&](long long sum) {
+                calls++;
+                total = sum;
+            }, 1);
+            vector<thread> threads;
+            for (int t = 0; t < 8; t++) {
+                threads.emplace_back([result] {
+                    for (int i = 1; i <= 1000; i++) {
+                        auto branch = result;
+                        *branch += i;
+                    }
+                });
+            }
+            for (auto& t : threads)
+                t.join();
+            ASSERT_EQ(calls.load(), 0);
+        }
+        ASSERT_EQ(calls.load(), 1);
+        ASSERT_EQ(total, 8 * 500500LL + 1);
+    }
+
+    TEST(LAsync, ConcurrentResultCombineTest)
+    {
+        size_t length = 0;
+        {
+            concurrent_result<string> result([&](string s) { length = s.size(); });
+            vector<thread> threads;
+            for (int t = 0; t < 4; t++) {
+                threads.emplace_back([result]() mutable {
+                    for (int i = 0; i < 100; i++) {
+                        auto branch = result;
+                        branch->append("ab");
+                    }
+                    *result += "c";
+                });
+            }
+            for (auto& t : threads)
+                t.join();
+        }
+        ASSERT_EQ(length, size_t(4 * 201));
+    }
+}
@@ -0,0 +1,109 @@
+#include <exception>
+using std::exception_ptr;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_coro.h"
+using l_async::task;
+using l_async::slot;
+using l_async::loop;
+using l_async::awaitable_result;
+
+namespace
+{
+    slot<optional<int>> numbers(executor& ex, int to, bool async)
+    {
+        slot<optional<int>> result;
+        loop producing([&ex, to, async, sink = result.get_provider(), i = 0](auto next) mutable {
+            sink.await([&, next] {
+                auto v = i < to ? optional<int>(i++) : nullopt;
+                if (async) {
+                    ex.schedule([&, next, v] {
+                        sink(v);
+                        next();
+                    });
+                } else {
+                    sink(v);
+                    next();
+                }
+            });
+        });
+        return result;
+    }
+
+    task<long long> sum(slot<optional<int>> stream)
+    {
+        long long total = 0;
+        while (auto v = co_await stream)
+            total += *v;
+        co_return total;
+    }
+
+    task<int> depth(int n)
+    {
+        if (n == 0)
+            co_return 0;
+        co_return 1 + co_await depth(n - 1);
+    }
+
+    task<int> fan_in(executor& ex)
+    {
+        awaitable_result<int> total;
+        for (int i = 1; i <= 10; i++) {
+            ex.schedule([r = total.get(), i]() mutable { *r += i; });
+        }
+        int r = co_await std::move(total);
+        co_await l_async::schedule_on(ex);
+        co_return r + co_await depth(5);
+    }
+
+    TEST(LAsync, CoroutineSlotTest)
+    {
+        executor ex;
+        long long async_total = 0, sync_total = 0;
+        sum(numbers(ex, 100, true)).start(ex, [&](long long v) { async_total = v; });
+        sum(numbers(ex, 1000000, false)).start(ex, [&](long long v) { sync_total = v; });
+        ex.execute();
+        ASSERT_EQ(async_total, 4950LL);
+        ASSERT_EQ(sync_total, 999999LL * 1000000 / 2) << "synchronous provider must not grow the stack";
+    }
+
+    TEST(LAsync, CoroutineJoinTest)
+    {
+        executor ex;
+        int deep = 0, joined = 0;
+        depth(1000).start(ex, [&](int v) { deep = v; });
+        fan_in(ex).start(ex, [&](int v) { joined = v; });
+        ex.execute();
+        ASSERT_EQ(deep, 1000);
+        ASSERT_EQ(joined, 60);
+    }
+
+    task<int> failing(int n)
+    {
+        if (n == 0)
+            throw runtime_error("unreadable");
+        co_return co_await failing(n - 1) + 1;
+    }
+
+    TEST(LAsync, CoroutineErrorTest)
+    {
+        executor ex;
+        int done = 0;
+        exception_ptr error;
+        failing(10).start(ex, [&](int) { done++; }, [&](exception_ptr e) { error = e; });
+        ex.execute();
+        ASSERT_EQ(done, 0);
+        ASSERT_TRUE(!!error);
+    }
+}
@@ -0,0 +1,86 @@
+#include <atomic>
+using std::atomic;
+
+#include "single_thread_executor.h"
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_priority_executor.h"
+#include "l_async_thread_pool.h"
+using l_async::priority_executor;
+using l_async::thread_pool_executor;
+
+namespace
+{
+    template<typename Executor>
+    struct nested_dispatch
+    {
+        Executor& ex;
+        int left;
+        int depth = 0;
+        int max_depth = 0;
+        int deferred = 0;
+
+        void step()
+        {
+            if (left-- == 0)
+                return;
+            depth++;
+            max_depth = depth > max_depth ? depth : max_depth;
+            ex.dispatch([this] {
+                if (depth == 0)
+                    deferred++;  // The task was scheduled, the dispatching frames are gone.
+                step();
+            });
+            depth--;
+        }
+    };
+
+    TEST(LAsync, DispatchSingleThreadTest)
+    {
+        testing::single_thread_executor ex(4);
+        bool ran = false;
+        ex.dispatch([&] { ran = true; });
+        ASSERT_FALSE(ran);  // Not on the executor, so the task is queued.
+        ex.execute();
+        ASSERT_TRUE(ran);
+
+        nested_dispatch<testing::single_thread_executor> chain{ ex, 20 };
+        ex.schedule([&] { chain.step(); });
+        ex.execute();
+        ASSERT_EQ(chain.left, -1);
+        ASSERT_EQ(chain.max_depth, 5);  // 4 inline frames on top of the first scheduled one.
+        ASSERT_EQ(chain.deferred, 4);   // Dispatches of steps 5, 10, 15 and 20 are deferred by the depth budget.
+    }
+
+    TEST(LAsync, DispatchPriorityTest)
+    {
+        priority_executor ex(2);
+        nested_dispatch<priority_executor> chain{ ex, 9 };
+        ex.schedule([&] { chain.step(); }, l_async::priority::high);
+        ex.execute();
+        ASSERT_EQ(chain.left, -1);
+        ASSERT_EQ(chain.max_depth, 3);
+        ASSERT_EQ(chain.deferred, 3);
+    }
+
+    TEST(LAsync, DispatchThreadPoolTest)
+    {
+        thread_pool_executor ex(2, 8);
+        atomic<bool> inline_on_worker{ false };
+        atomic<bool> queued_from_outside{ false };
+        atomic<bool> returned{ false };
+        ex.schedule([&] {
+            size_t worker = ex.current_worker_index();
+            ex.dispatch([&, worker] {
+                inline_on_worker = !returned && ex.current_worker_index() == worker;
+            });
+            returned = true;
+        });
+        bool called = false;
+        ex.dispatch([&] { queued_from_outside = ex.current_worker_index() < ex.size(); called = true; });
+        ex.execute();
+        ASSERT_TRUE(inline_on_worker.load());
+        ASSERT_TRUE(queued_from_outside.load());
+        ASSERT_TRUE(called);
+    }
+}
@@ -0,0 +1,140 @@
+#include <atomic>
+using std::atomic;
+
+#include <exception>
+using std::exception_ptr;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include <system_error>
+using std::error_code;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_thread_pool.h"
+using l_async::cancellation_source;
+using l_async::fallible_result;
+using l_async::local_fallible_result;
+using l_async::loop;
+using l_async::thread_pool_executor;
+
+namespace
+{
+    // Visits a tree of `fan_out^depth` leaves, each visit is a task; the leaf `bad_leaf` fails.
+    template<typename Executor, typename Result>
+    void scan(Executor& ex, int depth, int fan_out, int& leaf, int bad_leaf, Result result)
+    {
+        if (depth == 0) {
+            if (leaf++ == bad_leaf)
+                result.fail(std::make_error_code(std::errc::permission_denied));
+            else
+                *result += 1;
+            return;
+        }
+        for (int i = 0; i < fan_out; i++) {
+            ex.schedule([&, depth, fan_out, bad_leaf, result] {
+                if (!result.failed())
+                    scan(ex, depth - 1, fan_out, leaf, bad_leaf, result);
+            });
+        }
+    }
+
+    TEST(LAsync, FallibleResultSuccessTest)
+    {
+        executor ex;
+        int leaf = 0, calls = 0, total = 0;
+        scan(ex, 3, 4, leaf, -1, local_fallible_result<int, error_code>([&](int n, error_code error) {
+            ASSERT_TRUE(!error);
+            total = n;
+            calls++;
+        }));
+        ex.execute();
+        ASSERT_EQ(calls, 1);
+        ASSERT_EQ(total, 64);
+    }
+
+    TEST(LAsync, FallibleResultShortCircuitTest)
+    {
+        executor ex;
+        int leaf = 0, calls = 0, counted = -1, leaves_at_failure = -1;
+        error_code reported;
+        scan(ex, 6, 4, leaf, 10, local_fallible_result<int, error_code>([&](int n, error_code error) {
+            calls++;
+            counted = n;
+            reported = error;
+            leaves_at_failure = leaf;
+        }));
+        ex.execute();
+        ASSERT_EQ(calls, 1);
+        ASSERT_TRUE(reported == std::errc::permission_denied);
+        ASSERT_EQ(counted, 10);
+        ASSERT_EQ(leaves_at_failure, 11) << "fired by the failure, not by the end of the scan";
+        ASSERT_LT(leaf, 4 * 4 * 4 * 4 * 4 * 4 / 10) << "the siblings stop visiting";
+    }
+
+    TEST(LAsync, FallibleResultFirstErrorTest)
+    {
+        int calls = 0;
+        exception_ptr reported;
+        local_fallible_result<int> result([&](int, exception_ptr error) {
+            calls++;
+            reported = error;
+        });
+        auto first = std::make_exception_ptr(runtime_error("first"));
+        ASSERT_TRUE(result.fail(first));
+        ASSERT_FALSE(result.fail(std::make_exception_ptr(runtime_error("second"))));
+        ASSERT_TRUE(result.failed());
+        ASSERT_EQ(calls, 1);
+        ASSERT_TRUE(reported == first);
+    }
+
+    TEST(LAsync, FallibleResultGuardTest)
+    {
+        executor ex;
+        int calls = 0, iterations = 0;
+        exception_ptr reported;
+        {
+            cancellation_source source;
+            loop sibling(source.get_token(), [&](auto next) {
+                iterations++;
+                ex.schedule(next);  // Stops on cancellation by the failure.
+            });
+            local_fallible_result<int> result(source, [&](int, exception_ptr error) {
+                calls++;
+                reported = error;
+            });
+            ex.schedule(result.guard([] { throw runtime_error("unreadable"); }));
+            ex.schedule(result.guard([&] { iterations += 1000; }));  // Skipped, the result has failed.
+        }
+        ex.execute();
+        ASSERT_EQ(calls, 1);
+        ASSERT_TRUE(!!reported);
+        ASSERT_LT(iterations, 10);
+    }
+
+    TEST(LAsync, FallibleResultThreadPoolTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<int> calls = 0, failures = 0;
+        {
+            fallible_result<int> result([&](int, exception_ptr error) {
+                calls++;
+                if (error)
+                    failures++;
+            });
+            for (int i = 0; i < 1000; i++) {
+                ex.schedule(result.guard([i] {
+                    if (i % 100 == 99)
+                        throw runtime_error("bad");
+                }));
+            }
+        }
+        ex.execute();
+        ASSERT_EQ(calls.load(), 1);
+        ASSERT_EQ(failures.load(), 1);
+    }
+}
@@ -1,10 +1,34 @@
 #include "gunit.h"
+#include <cassert>
+#include <cstdlib>
+#include <new>
 #include <vector>
 
 namespace testing {
     TestRegRecord* tests = nullptr;
     int failed;
 
+    thread_local size_t allocations = 0;
+    thread_local AllocScope* alloc_scope = nullptr;
+
+    AllocScope::AllocScope()
+        : start(allocations), outer(alloc_scope) {
+        alloc_scope = this;
+    }
+
+    AllocScope::~AllocScope() {
+        alloc_scope = outer;
+    }
+
+    size_t AllocScope::count() const {
+        return allocations - start;
+    }
+
+    AllocScope& AllocScope::current() {
+        assert(alloc_scope);
+        return *alloc_scope;
+    }
+
     TestRegRecord::TestRegRecord(const char* name, Test* (*fn)())
         : name(name), fn(fn), next(tests) {
         tests = this;
@@ -33,6 +57,24 @@ int RUN_ALL_TESTS() {
     return ::testing::failed;
 }
 
+void* operator new(size_t size)
+{
+    ++testing::allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
 int main()
 {
     return RUN_ALL_TESTS();
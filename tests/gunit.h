@@ -4,6 +4,7 @@
 // A simple version of test framework that mimics gunit.
 // Has no external dependencies.
 
+#include <cstddef>
 #include <iostream>
 
 namespace testing
@@ -41,6 +42,20 @@ namespace testing
         }
     };
 
+    // Counts heap allocations made by the current thread through global `operator new` (replaced in gunit.cpp)
+    // while the scope is alive; `ASSERT_ALLOCS_*` check the innermost scope.
+    class AllocScope {
+        size_t start;
+        AllocScope* outer;
+    public:
+        AllocScope();
+        ~AllocScope();
+        AllocScope(const AllocScope&) = delete;
+        void operator= (const AllocScope&) = delete;
+        size_t count() const;
+        static AllocScope& current();
+    };
+
     struct fail {
         const char* file;
         int line;
@@ -92,4 +107,7 @@ int RUN_ALL_TESTS();
 #define EXPECT_TRUE(A) EXPECT_COND(A, true, std::equal_to, "!=")
 #define EXPECT_FALSE(A) EXPECT_COND(A, false, std::equal_to, "!=")
 
+#define ASSERT_ALLOCS_EQ(N) ASSERT_EQ(::testing::AllocScope::current().count(), size_t(N))
+#define ASSERT_ALLOCS_LE(N) ASSERT_LE(::testing::AllocScope::current().count(), size_t(N))
+
 #endif  // _GUNIT_H_
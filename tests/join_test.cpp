@@ -0,0 +1,76 @@
+#include <memory>
+using std::unique_ptr;
+using std::make_unique;
+
+#include <optional>
+using std::optional;
+
+#include <string>
+using std::string;
+
+#include <thread>
+using std::thread;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::join;
+
+namespace
+{
+    TEST(LAsync, JoinTest)
+    {
+        executor ex;
+        int calls = 0;
+        {
+            join<int, string, unique_ptr<int>> all([&](int a, string b, unique_ptr<int> c) {
+                calls++;
+                ASSERT_EQ(a, 1);
+                ASSERT_EQ(b, string("two"));
+                ASSERT_EQ(*c, 3);
+            });
+            ex.schedule([s = all.get<2>()]() mutable { s(make_unique<int>(3)); });
+            ex.schedule([s = all.get<0>()]() mutable { s(1); });
+            all.get<1>()("two");
+        }
+        ASSERT_EQ(calls, 0);  // Waits for the last arrival.
+        ex.execute();
+        ASSERT_EQ(calls, 1);
+    }
+
+    TEST(LAsync, JoinDroppedSetterTest)
+    {
+        optional<int> first = 0;
+        optional<int> second = 0;
+        {
+            join<optional<int>, optional<int>> both([&](optional<int> a, optional<int> b) {
+                first = a;
+                second = b;
+            });
+            auto s = both.get<0>();
+            auto moved = std::move(s);
+            moved(5);
+            // The second setter is never taken.
+        }
+        ASSERT_EQ(*first, 5);
+        ASSERT_FALSE(second.has_value());
+    }
+
+    TEST(LAsync, JoinThreadsTest)
+    {
+        for (int attempt = 0; attempt < 100; attempt++) {
+            int sum = 0;
+            thread a, b;
+            {
+                join<int, int> both([&](int x, int y) { sum = x + y; });
+                a = thread([attempt, s = both.get<0>()]() mutable { s(attempt); });
+                b = thread([s = both.get<1>()]() mutable { s(1); });
+            }
+            a.join();
+            b.join();
+            ASSERT_EQ(sum, attempt + 1);
+        }
+    }
+}
@@ -1,10 +1,16 @@
 #include <functional>
 using std::function;
 
+#include <memory>
+using std::make_unique;
+
 #include <optional>
 using std::optional;
 using std::nullopt;
 
+#include <vector>
+using std::vector;
+
 #include "single_thread_executor.h"
 #include "gunit.h"
 #include "l_async.h"
@@ -66,4 +72,125 @@ namespace
         });
         executor.execute();
     }
+
+    TEST(LAsync, TypedLoopTest)
+    {
+        testing::single_thread_executor executor;
+        async_or_async_data_stream stream(executor);
+        int sum = 0;
+        l_async::basic_loop<void, l_async::single_threaded> erased([&, stream](auto next) mutable {
+            stream.get_next([&, next](auto data) {
+                if (!data) return;
+                sum += *data;
+                next();
+            });
+        });
+        l_async::basic_loop typed([&, i = 0, data = make_unique<int>(10)](auto next) mutable {
+            if (++i < *data)
+                next();
+            else
+                sum += i;
+        });
+        executor.execute();
+        ASSERT_EQ(sum, 55);
+    }
+
+    TEST(LAsync, DrainBatchesTest)
+    {
+        testing::single_thread_executor executor;
+        int batches = 0;
+        int sum = 0;
+        l_async::drain_batches(
+            [&, left = 100000](auto callback) mutable {
+                vector<int> batch;
+                for (; left > 0 && batch.size() < 3; left--)
+                    batch.push_back(left);
+                if (batches % 2)
+                    callback(move(batch));  // synchronous batches must not grow the stack
+                else
+                    executor.schedule([callback, batch = move(batch)]() mutable { callback(move(batch)); });
+            },
+            [&](vector<int> batch) {
+                batches++;
+                for (int v : batch)
+                    sum += v % 10;
+            });
+        executor.execute();
+        ASSERT_EQ(batches, 33334);
+        ASSERT_EQ(sum, 450000);
+    }
+
+    TEST(LAsync, LoopAllocationsTest)
+    {
+        {
+            testing::AllocScope allocs;
+            l_async::loop counting([i = 0](auto next) mutable {
+                if (++i < 1000)
+                    next();
+            });
+            ASSERT_ALLOCS_EQ(1);  // One block for the loop, synchronous restarts allocate nothing.
+        }
+        {
+            l_async::unique_function<void()> pending;
+            testing::AllocScope allocs;
+            l_async::loop counting([&, i = 0](auto next) mutable {
+                if (++i < 1000)
+                    pending = next;  // `next` fits inline into `unique_function`.
+            });
+            while (pending) {
+                auto iteration = std::move(pending);
+                iteration();
+            }
+            ASSERT_ALLOCS_EQ(1);  // Asynchronous iterations allocate nothing either.
+        }
+        {
+            testing::single_thread_executor executor;
+            int iterations = 0;
+            auto run = [&](int n) {
+                l_async::loop counting([&, n, i = 0](auto next) mutable {
+                    iterations++;
+                    if (++i < n)
+                        executor.schedule(next);
+                });
+                executor.execute();
+            };
+            run(100);  // Warms up the executor buffers.
+            testing::AllocScope allocs;
+            run(1000);
+            ASSERT_EQ(iterations, 1100);
+            ASSERT_ALLOCS_EQ(1);  // Only the loop block, scheduled continuations reuse executor buffers.
+        }
+    }
+
+    TEST(LAsync, LoopNestedRestartTest)
+    {
+        int outer_iterations = 0, inner_iterations = 0;
+        l_async::loop outer([&](auto next) {
+            if (++outer_iterations == 3)
+                return;
+            l_async::loop inner([&, next, i = 0](auto inner_next) mutable {
+                inner_iterations++;
+                if (++i < 2)
+                    inner_next();
+                else
+                    next();  // Restarts the outer loop from the body of another one.
+            });
+        });
+        ASSERT_EQ(outer_iterations, 3);
+        ASSERT_EQ(inner_iterations, 4);
+
+        int thrown = 0;
+        try {
+            l_async::loop failing([](auto) { throw 1; });
+        } catch (int) {
+            thrown++;
+        }
+        int iterations = 0;
+        l_async::loop after([&](auto next) {
+            if (++iterations < 3)
+                next();
+        });
+        ASSERT_EQ(thrown, 1);
+        ASSERT_EQ(iterations, 3) << "a body that threw does not stay marked as running";
+    }
 }
@@ -0,0 +1,140 @@
+#include <atomic>
+using std::atomic;
+
+#include <thread>
+using std::thread;
+
+#include <vector>
+using std::vector;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_mpsc.h"
+using l_async::loop;
+
+namespace
+{
+    struct node
+    {
+        atomic<node*> next{ nullptr };
+        int producer = 0;
+        int seq = 0;
+    };
+
+    TEST(LAsync, MpscQueueTest)
+    {
+        const int producers = 4;
+        const int per_producer = 100000;
+        l_async::mpsc_queue<node> queue;
+        vector<node> nodes(producers * per_producer);
+        vector<thread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&, p] {
+                for (int i = 0; i < per_producer; i++) {
+                    node& n = nodes[p * per_producer + i];
+                    n.producer = p;
+                    n.seq = i;
+                    queue.push(&n);
+                }
+            });
+        }
+        vector<int> next_seq(producers, 0);
+        bool ordered = true;
+        for (int taken = 0; taken < producers * per_producer;) {
+            if (node* n = queue.pop()) {
+                ordered = ordered && n->seq == next_seq[n->producer]++;  // FIFO per producer.
+                taken++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        for (auto& t : threads)
+            t.join();
+        ASSERT_TRUE(ordered);
+        ASSERT_TRUE(queue.pop() == nullptr);
+        ASSERT_TRUE(queue.empty());
+    }
+
+    TEST(LAsync, ExecutorPostTest)
+    {
+        executor ex;
+        int sum = 0;
+        int done = 0;
+        vector<thread> io_threads;
+        for (int p = 0; p < 4; p++) {
+            io_threads.emplace_back([&, p] {
+                for (int i = 1; i <= 1000; i++) {
+                    ex.post([&, i, last = i == 1000] {
+                        sum += i;  // Runs on the executor thread.
+                        done += last;
+                    });
+                }
+            });
+        }
+        while (done < 4) {
+            ex.wait();
+            ex.execute();
+        }
+        for (auto& t : io_threads)
+            t.join();
+        ASSERT_EQ(sum, 4 * 1000 * 1001 / 2);
+    }
+
+    TEST(LAsync, ExecutorPostLoopTest)
+    {
+        // Completions of a loop iterations come from another thread.
+        executor ex;
+        atomic<bool> finished = false;
+        thread io;
+        int iterations = 0;
+        loop reading([&](auto next) {
+            if (++iterations == 100) {
+                finished = true;
+                return;
+            }
+            if (io.joinable())
+                io.join();
+            io = thread([&, next] { ex.post(next); });
+        });
+        while (!finished) {
+            ex.wait();
+            ex.execute();
+        }
+        io.join();
+        ASSERT_EQ(iterations, 100);
+    }
+
+    TEST(LAsync, ExecutorPostAllocationsTest)
+    {
+        // This thread posts, the executor runs on another one.
+        executor ex;
+        atomic<int> executed = 0;
+        bool stop = false;  // Set on the executor thread.
+        thread executing([&] {
+            while (!stop) {
+                ex.wait();
+                ex.execute();
+            }
+        });
+        auto post_and_wait = [&](int n) {
+            for (int i = 0; i < n; i++) {
+                int expected = executed.load() + 1;
+                ex.post([&] { executed++; });
+                while (executed.load() < expected)
+                    std::this_thread::yield();
+            }
+        };
+        post_and_wait(10);  // The first nodes are allocated, then the drained ones come back.
+        {
+            testing::AllocScope allocs;
+            post_and_wait(1000);
+            ASSERT_ALLOCS_EQ(0);
+        }
+        ex.post([&] { stop = true; });
+        executing.join();
+        ASSERT_EQ(executed.load(), 1010);
+    }
+}
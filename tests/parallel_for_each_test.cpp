@@ -0,0 +1,102 @@
+#include <atomic>
+using std::atomic;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <memory>
+using std::unique_ptr;
+using std::make_unique;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_thread_pool.h"
+using l_async::parallel_for_each;
+using l_async::result;
+using l_async::concurrent_result;
+using l_async::thread_pool_executor;
+
+namespace
+{
+    TEST(LAsync, ParallelForEachTest)
+    {
+        executor ex;
+        int in_flight = 0, max_in_flight = 0, total = 0;
+        parallel_for_each(
+            [&, i = 0](auto callback) mutable {
+                ex.schedule([callback = std::move(callback), v = i < 100 ? make_unique<int>(++i) : nullptr]() mutable {
+                    callback(std::move(v));
+                });
+            },
+            3,
+            [&](unique_ptr<int> item, auto next, result<int> sum) {
+                in_flight++;
+                if (in_flight > max_in_flight)
+                    max_in_flight = in_flight;
+                l_async::loop delay([&, next, sum, v = *item, hops = 0](auto again) mutable {
+                    if (++hops < 10) {
+                        ex.schedule(again);
+                    } else {
+                        *sum += v;
+                        in_flight--;
+                        next();
+                    }
+                });
+            },
+            result<int>([&](int sum) { total = sum; }));
+        ex.execute();
+        ASSERT_EQ(total, 5050);
+        ASSERT_EQ(max_in_flight, 3);
+        ASSERT_EQ(in_flight, 0);
+    }
+
+    TEST(LAsync, ParallelForEachSyncTest)
+    {
+        int count = -1;
+        parallel_for_each(
+            [i = 0](auto callback) mutable {
+                callback(i < 100000 ? optional<int>(i++) : nullopt);
+            },
+            4,
+            [](auto, auto next, result<int> count) {
+                *count += 1;
+                next();
+            },
+            result<int>([&](int n) { count = n; }));
+        ASSERT_EQ(count, 100000);
+    }
+
+    TEST(LAsync, ParallelForEachThreadPoolTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<int> in_flight = 0, max_in_flight = 0, total = 0;
+        parallel_for_each(
+            [i = 0](auto callback) mutable {
+                callback(i < 10000 ? optional<int>(++i) : nullopt);
+            },
+            8,
+            [&](optional<int> item, auto next, concurrent_result<int> sum) {
+                int now = ++in_flight;
+                for (int seen = max_in_flight; now > seen && !max_in_flight.compare_exchange_weak(seen, now);)
+                {}
+                l_async::loop delay([&, next, sum, v = *item, hops = 0](auto again) mutable {
+                    if (++hops < 3) {
+                        ex.schedule(again);
+                    } else {
+                        *sum += v;
+                        in_flight--;
+                        ex.schedule(next);
+                    }
+                });
+            },
+            concurrent_result<int>([&](int sum) { total = sum; }));
+        ex.execute();
+        ASSERT_EQ(total.load(), 50005000);
+        ASSERT_EQ(in_flight.load(), 0);
+        ASSERT_TRUE(max_in_flight.load() <= 8) << "max_in_flight " << max_in_flight.load();
+    }
+}
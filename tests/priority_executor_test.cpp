@@ -0,0 +1,63 @@
+#include <chrono>
+using std::chrono::milliseconds;
+
+#include <vector>
+using std::vector;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_priority_executor.h"
+using l_async::loop;
+using l_async::priority;
+using l_async::priority_executor;
+
+namespace
+{
+    TEST(LAsync, PriorityPropagationTest)
+    {
+        priority_executor ex;
+        int background_done = 0;
+        int background_done_before_client = -1;
+        for (int i = 0; i < 100; i++)
+            ex.schedule([&] { background_done++; }, priority::background);
+        {
+            priority_executor::scope client(priority::high);
+            loop serving([&, i = 0](auto next) mutable {
+                ASSERT_TRUE(priority_executor::current_priority() == priority::high);
+                if (++i < 5)
+                    ex.schedule(next);  // inherits the priority
+                else
+                    background_done_before_client = background_done;
+            });
+        }
+        ASSERT_TRUE(priority_executor::current_priority() == priority::normal);
+        ex.execute();
+        ASSERT_EQ(background_done_before_client, 0);
+        ASSERT_EQ(background_done, 100);
+    }
+
+    TEST(LAsync, PriorityDeadlineTest)
+    {
+        priority_executor ex;
+        auto now = priority_executor::clock::now();
+        vector<int> order;
+        ex.schedule([&] { order.push_back(5); });
+        ex.schedule([&] { order.push_back(6); });
+        ex.schedule([&] { order.push_back(4); }, priority::normal, now + milliseconds(30));
+        ex.schedule([&] { order.push_back(2); }, priority::normal, now + milliseconds(10));
+        ex.schedule([&] { order.push_back(3); }, priority::normal, now + milliseconds(20));
+        ex.schedule([&] { order.push_back(7); }, priority::background, now);
+        ex.schedule([&] {
+            order.push_back(0);
+            ASSERT_TRUE(priority_executor::current_deadline() == now + milliseconds(50));
+            ex.schedule([&] {  // inherits the priority and deadline
+                ASSERT_TRUE(priority_executor::current_deadline() == now + milliseconds(50));
+                order.push_back(1);
+            });
+        }, priority::high, now + milliseconds(50));
+        ASSERT_EQ(int(ex.size()), 7);
+        ex.execute();
+        ASSERT_TRUE(order == (vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 }));
+        ASSERT_EQ(int(ex.size()), 0);
+    }
+}
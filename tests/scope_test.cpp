@@ -0,0 +1,124 @@
+#include <atomic>
+using std::atomic;
+
+#include <exception>
+using std::exception_ptr;
+
+#include <optional>
+using std::optional;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_thread_pool.h"
+using l_async::scope;
+using l_async::local_scope;
+using l_async::thread_pool_executor;
+
+namespace
+{
+    // A child of `depth` iterates `depth + 1` times asynchronously and spawns a child of `depth - 1` on each iteration but the last.
+    template<typename Scope, typename Executor>
+    void grow(const Scope& s, Executor& ex, int depth, atomic<int>& visited)
+    {
+        s.spawn([&ex, &visited, depth, i = 0](auto next, const Scope& s) mutable {
+            visited++;
+            if (i++ == depth)
+                return;
+            grow(s, ex, depth - 1, visited);
+            ex.schedule(next);
+        });
+    }
+
+    int visits(int depth)
+    {
+        return depth == 0 ? 1 : depth + 1 + depth * visits(depth - 1);
+    }
+
+    TEST(LAsync, ScopeJoinTest)
+    {
+        executor ex;
+        atomic<int> visited = 0;
+        int done = 0;
+        {
+            local_scope s([&](exception_ptr error) {
+                ASSERT_TRUE(!error);
+                done++;
+            });
+            grow(s, ex, 4, visited);
+            auto pending = s.enter();  // Not a loop, e.g. a callback of an async operation.
+            ex.schedule([pending = std::move(pending)] {});
+        }
+        ASSERT_EQ(done, 0);
+        ex.execute();
+        ASSERT_EQ(done, 1);
+        ASSERT_EQ(visited.load(), visits(4));
+    }
+
+    optional<std::string> error_message(exception_ptr error)
+    {
+        try {
+            if (error)
+                std::rethrow_exception(error);
+        } catch (const runtime_error& e) {
+            return e.what();
+        }
+        return std::nullopt;
+    }
+
+    TEST(LAsync, ScopeErrorTest)
+    {
+        executor ex;
+        int iterations = 0, done = 0;
+        optional<std::string> message;
+        {
+            local_scope s([&](exception_ptr error) {
+                done++;
+                message = error_message(error);
+            });
+            s.spawn([&](auto next) {
+                iterations++;
+                ex.schedule(next);  // Stops after the sibling fails.
+            });
+            s.spawn([&, i = 0](auto next) mutable {
+                if (++i == 3)
+                    throw runtime_error("disk error");
+                ex.schedule(next);
+            });
+        }
+        ex.execute();
+        ASSERT_EQ(done, 1);
+        ASSERT_TRUE(message == std::string("disk error"));
+        ASSERT_EQ(iterations, 3);
+    }
+
+    TEST(LAsync, ScopeFirstErrorTest)
+    {
+        optional<std::string> message;
+        {
+            local_scope s([&](exception_ptr error) { message = error_message(error); });
+            s.fail(std::make_exception_ptr(runtime_error("first")));
+            s.fail(std::make_exception_ptr(runtime_error("second")));
+            ASSERT_TRUE(s.failed());
+            int iterations = 0;
+            s.spawn([&](auto) { iterations++; });
+            ASSERT_EQ(iterations, 0) << "children of a failed scope do not start";
+        }
+        ASSERT_TRUE(message == std::string("first"));
+    }
+
+    TEST(LAsync, ScopeThreadPoolTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<int> visited = 0, done = 0;
+        grow(scope([&](exception_ptr) { done++; }), ex, 8, visited);
+        ex.execute();
+        ASSERT_EQ(done.load(), 1);
+        ASSERT_EQ(visited.load(), visits(8));
+    }
+}
@@ -1,42 +1,172 @@
 #ifndef _SUNGLE_THREAD_EXECUTOR_H_
 #define _SUNGLE_THREAD_EXECUTOR_H_
 
+#include <atomic>
+#include <thread>
 #include <vector>
-#include <functional>
+#include <utility>
+
+#include "l_async.h"
+#include "l_async_mpsc.h"
 
 namespace testing {
 
     /// <summary>
     /// Executes tasks in single thread at the the moment explicitly defined by caller.
+    /// Tasks of the executor thread go to a plain vector (of inline `unique_function`s, reused between rounds, so the steady state
+    /// scheduling does not allocate), other threads `post` tasks
+    /// through a lock-free queue of intrusive nodes, that `execute` drains by batches.
+    /// Drained nodes go back to the posting threads through a lock-free list, so steady-state posting does not allocate either.
     /// Intended primarily for testing purposes.
     /// </summary>
     class single_thread_executor
     {
-        std::vector<std::function<void()>> tasks;
+        struct posted_task
+        {
+            std::atomic<posted_task*> next{ nullptr };
+            l_async::unique_function<void()> fn;
+            posted_task* next_free = nullptr;
+        };
+
+        // Per-thread freelist of posted nodes, refilled with whole lists of nodes drained by executors.
+        class node_cache
+        {
+            posted_task* head = nullptr;
+
+        public:
+            ~node_cache()
+            {
+                while (head)
+                    delete std::exchange(head, head->next_free);
+            }
+
+            posted_task* make(l_async::unique_function<void()>&& fn, std::atomic<posted_task*>& drained)
+            {
+                if (!head)
+                    head = drained.exchange(nullptr, std::memory_order_acquire);  // Whole lists are taken, so there is no ABA.
+                if (!head)
+                    return new posted_task{ {}, std::move(fn) };
+                posted_task* t = std::exchange(head, head->next_free);
+                t->fn = std::move(fn);
+                return t;
+            }
+        };
+
+        static node_cache& cache()
+        {
+            static thread_local node_cache c;
+            return c;
+        }
+
+        std::vector<l_async::unique_function<void()>> tasks;
+        std::vector<l_async::unique_function<void()>> spare_tasks;  // Buffer of the executed batch, kept for its capacity.
+        l_async::mpsc_queue<posted_task> posted;
+        std::atomic<posted_task*> drained{ nullptr };  // Nodes taken from `posted`, pushed by the executor thread only.
+        l_async::wakeup wakeup;
+        std::atomic<bool> sleeping{ false };
+        size_t max_dispatch_depth;
+        size_t dispatch_depth = 0;
+        bool executing = false;
+
+        // Moves all posted tasks to `tasks`.
+        void take_posted()
+        {
+            posted_task* first = nullptr;
+            posted_task* last = nullptr;
+            for (;;) {
+                while (posted_task* t = posted.pop()) {
+                    tasks.emplace_back(std::move(t->fn));
+                    t->next_free = first;
+                    first = t;
+                    if (!last)
+                        last = t;
+                }
+                if (posted.empty())
+                    break;
+                std::this_thread::yield();  // A producer is between its two steps of `push`.
+            }
+            if (first) {
+                last->next_free = drained.load(std::memory_order_relaxed);
+                while (!drained.compare_exchange_weak(last->next_free, first, std::memory_order_release, std::memory_order_relaxed))
+                {}
+            }
+        }
 
     public:
         /// <summary>
-        /// Schedules a task for later execution.
+        /// `max_dispatch_depth` limits nesting of tasks run inline by `dispatch`.
+        /// </summary>
+        explicit single_thread_executor(size_t max_dispatch_depth = 16)
+            : max_dispatch_depth(max_dispatch_depth)
+        {}
+
+        ~single_thread_executor()
+        {
+            while (posted_task* t = posted.pop())
+                delete t;
+            for (posted_task* t = drained.load(std::memory_order_acquire); t;)
+                delete std::exchange(t, t->next_free);
+        }
+
+        /// <summary>
+        /// Schedules a task for later execution. Must be called from the executor thread.
+        /// </summary>
+        void schedule(l_async::unique_function<void()> task)
+        {
+            tasks.emplace_back(std::move(task));
+        }
+
+        /// <summary>
+        /// Schedules a task from any thread (e.g. an I/O completion), wait-free unless the executor thread sleeps in `wait`.
+        /// </summary>
+        void post(l_async::unique_function<void()> task)
+        {
+            posted.push(cache().make(std::move(task), drained));
+            if (sleeping.load(std::memory_order_seq_cst))
+                wakeup.signal();
+        }
+
+        /// <summary>
+        /// Blocks the executor thread until there are tasks to execute (it may also return spuriously).
+        /// </summary>
+        void wait()
+        {
+            if (!tasks.empty())
+                return;
+            sleeping.store(true, std::memory_order_seq_cst);
+            if (posted.empty())
+                wakeup.wait();
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        /// <summary>
+        /// Runs the task right away if called from a task of this executor and the nesting budget allows,
+        /// otherwise schedules it.
         /// </summary>
-        void schedule(std::function<void()> task)
+        void dispatch(l_async::unique_function<void()> task)
         {
-            tasks.emplace_back(move(task));
+            if (!executing || !l_async::detail::run_inline(dispatch_depth, max_dispatch_depth, task))
+                schedule(std::move(task));
         }
 
         /// <summary>
-        /// Executes all tasks accumulated so far and all tasks scheduled from them.
+        /// Executes all tasks accumulated so far (including posted ones) and all tasks scheduled from them.
         /// </summary>
         void execute()
         {
-            while (!tasks.empty())
+            bool was_executing = std::exchange(executing, true);
+            std::vector<l_async::unique_function<void()>> batch(std::move(spare_tasks));
+            for (take_posted(); !tasks.empty(); take_posted())
             {
-                std::vector<std::function<void()>> current_tasks;
-                swap(current_tasks, tasks);
-                for (auto& t : current_tasks)
+                std::swap(batch, tasks);
+                for (auto& t : batch)
                 {
                     t();
                 }
+                batch.clear();
             }
+            spare_tasks = std::move(batch);
+            executing = was_executing;
         }
     };
 }
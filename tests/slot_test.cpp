@@ -14,6 +14,12 @@ using std::vector;
 #include <utility>
 using std::pair;
 
+#include <atomic>
+using std::atomic;
+
+#include <thread>
+using std::thread;
+
 #include <iostream>
 using std::cout;
 using std::endl;
@@ -148,4 +154,106 @@ namespace
         });
         ex.execute();
     }
+
+    TEST(LAsync, LocalSlotTest)
+    {
+        executor ex;
+        int sum = 0;
+        optional<l_async::local_slot<int>::provider> sink;
+        {
+            l_async::local_slot<int> numbers;
+            sink = numbers.get_provider();
+            l_async::local_loop providing([&ex, sink = numbers.get_provider(), i = 0](auto next) mutable {
+                sink.await([&, next] {
+                    ex.schedule([&, next] {
+                        sink(++i);
+                        next();
+                    });
+                });
+            });
+            l_async::local_result<int> total([&](int v) { sum = v; });
+            l_async::local_loop consuming([numbers, total](auto next) mutable {
+                numbers([&, next](int v) mutable {
+                    *total += v;
+                    if (v < 10)
+                        next();
+                });
+            });
+        }
+        ex.execute();
+        ASSERT_EQ(sum, 55);
+        int calls = 0;
+        sink->await([&] { calls++; });  // The slot is gone, its provider outlives it and ignores requests.
+        (*sink)(1);
+        ASSERT_EQ(calls, 0);
+    }
+
+    TEST(LAsync, SlotSyncHandoffTest)
+    {
+        vector<int> received;
+        int calls = 0;
+        optional<slot<int>> numbers(std::in_place);
+        auto sink = numbers->get_provider();
+        for (int i = 0; i < 3; i++) {
+            (*numbers)([&](int v) { received.push_back(v); });
+            sink.await([&, i] { sink(i); });  // The consumer waits, the request is served inline.
+        }
+        sink.await([&] {
+            calls++;
+            sink(3);
+        });
+        // The stored request is called by the consumer and answers synchronously, the listener drops the last slot reference.
+        (*numbers)([&](int v) {
+            received.push_back(v);
+            numbers.reset();
+        });
+        ASSERT_EQ(calls, 1);
+        ASSERT_TRUE(received == vector<int>({ 0, 1, 2, 3 }));
+        sink.await([&] { calls++; });
+        sink(4);
+        ASSERT_EQ(calls, 1);
+    }
+
+    TEST(LAsync, SlotForeignThreadHandoffTest)
+    {
+        // The request listener runs inline on this thread and hands the provider to an I/O thread,
+        // which answers while this thread may still be leaving the inline request.
+        atomic<int> sum = 0;
+        for (int i = 0; i < 200; i++) {
+            slot<int> numbers;
+            auto sink = numbers.get_provider();
+            numbers([&](int v) { sum += v; });
+            thread io;
+            sink.await([&, i] {
+                io = thread([sink, i] { sink(i); });
+            });
+            io.join();
+        }
+        ASSERT_EQ(sum.load(), 199 * 200 / 2);
+    }
+
+    TEST(LAsync, SlotAllocationsTest)
+    {
+        size_t received = 0;
+        testing::AllocScope allocs;
+        {
+            slot<optional<int>> numbers;
+            loop providing([sink = numbers.get_provider(), i = 0](auto next) mutable {
+                sink.await([&, next] {
+                    sink(i < 1000 ? optional<int>(i++) : nullopt);
+                    next();
+                });
+            });
+            loop consuming([&, numbers](auto next) mutable {
+                numbers([&, next](auto v) {
+                    if (!v)
+                        return;
+                    received++;
+                    next();
+                });
+            });
+        }
+        ASSERT_EQ(received, size_t(1000));
+        ASSERT_ALLOCS_EQ(3);  // The slot and two loops, handoffs store listeners inline.
+    }
 }
@@ -0,0 +1,168 @@
+#include <algorithm>
+
+#include <memory>
+using std::unique_ptr;
+using std::make_unique;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <utility>
+using std::pair;
+
+#include <vector>
+using std::vector;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_streams.h"
+using l_async::loop;
+using l_async::slot;
+namespace streams = l_async::streams;
+
+namespace
+{
+    template<typename S>
+    auto collect(S s)
+    {
+        vector<streams::value_t<S>> items;
+        bool ended = false;
+        streams::for_each(std::move(s), [&](auto v) { items.push_back(std::move(v)); }, [&] { ended = true; });
+        EXPECT_TRUE(ended);
+        return items;
+    }
+
+    // Asynchronous source of `0, 1, ... n - 1` items, each one delivered by a separate task.
+    slot<optional<int>> async_range(executor& ex, int n)
+    {
+        slot<optional<int>> result;
+        loop producing([&ex, n, i = 0, sink = result.get_provider()](auto next) mutable {
+            sink.await([&, next] {
+                ex.schedule([&, next] {
+                    sink(i < n ? optional<int>(i++) : nullopt);
+                    next();
+                });
+            });
+        });
+        return result;
+    }
+
+    TEST(LAsync, StreamsFusedTest)
+    {
+        vector<int> v;
+        for (int i = 0; i < 100; i++)
+            v.push_back(i);
+        auto pipeline = streams::iterate(v.begin(), v.end())
+            | streams::map([](int x) { return x * 2; })
+            | streams::filter([](int x) { return x % 3 == 0; })
+            | streams::take(4)
+            | streams::map([](int x) { return x + 1; });
+        static_assert(streams::is_fused<decltype(pipeline)>::value);
+        ASSERT_TRUE(collect(std::move(pipeline)) == vector<int>({ 1, 7, 13, 19 }));
+    }
+
+    TEST(LAsync, StreamsLongFilteredRunTest)
+    {
+        vector<int> v(1000000);
+        v.push_back(1);
+        // A million of synchronously rejected items are pulled by iterations, not recursion.
+        auto pipeline = streams::iterate(v.begin(), v.end()) | streams::filter([](int x) { return x != 0; });
+        ASSERT_TRUE(collect(std::move(pipeline)) == vector<int>({ 1 }));
+    }
+
+    TEST(LAsync, StreamsTakeZeroTest)
+    {
+        int requested = 0;
+        auto source = streams::as_stream<int>([&](auto callback) {
+            requested++;
+            callback(optional<int>(1));
+        });
+        ASSERT_EQ(collect(source | streams::take(0)).size(), size_t(0));
+        ASSERT_EQ(requested, 0);
+        ASSERT_EQ(collect(source | streams::take(3)).size(), size_t(3));
+        ASSERT_EQ(requested, 3);
+    }
+
+    TEST(LAsync, StreamsBufferTest)
+    {
+        vector<int> v = { 1, 2, 3, 4, 5 };
+        auto batches = collect(streams::iterate(v.begin(), v.end()) | streams::buffer(2) | streams::buffer(2));
+        ASSERT_EQ(batches.size(), size_t(2));
+        ASSERT_TRUE(batches[0] == vector<vector<int>>({ { 1, 2 }, { 3, 4 } }));
+        ASSERT_TRUE(batches[1] == vector<vector<int>>({ { 5 } }));  // Both incomplete batches are flushed at the end.
+    }
+
+    TEST(LAsync, StreamsAsyncTest)
+    {
+        executor ex;
+        vector<vector<int>> batches;
+        bool ended = false;
+        streams::for_each(
+            async_range(ex, 7) | streams::map([](int x) { return make_unique<int>(x); }) | streams::buffer(3),
+            [&](vector<unique_ptr<int>> batch) {
+                batches.emplace_back();
+                for (auto& p : batch)
+                    batches.back().push_back(*p);
+            },
+            [&] { ended = true; });
+        ASSERT_FALSE(ended);
+        ex.execute();
+        ASSERT_TRUE(ended);
+        ASSERT_TRUE(batches == vector<vector<int>>({ { 0, 1, 2 }, { 3, 4, 5 }, { 6 } }));
+    }
+
+    TEST(LAsync, StreamsNamedChainTest)
+    {
+        vector<int> v = { 1, 2, 3, 4 };
+        auto evens = streams::iterate(v.begin(), v.end()) | streams::filter([](int x) { return x % 2 == 0; });
+        auto squares = evens | streams::map([](int x) { return x * x; });  // A named chain is wrapped, not moved from.
+        ASSERT_TRUE(collect(squares) == vector<int>({ 4, 16 }));
+    }
+
+    TEST(LAsync, StreamsMergeTest)
+    {
+        executor ex;
+        vector<int> v = { 100, 101 };
+        vector<int> items;
+        bool ended = false;
+        streams::for_each(streams::merge(async_range(ex, 3), streams::iterate(v.begin(), v.end())),
+            [&](int x) { items.push_back(x); },
+            [&] { ended = true; });
+        ex.execute();
+        ASSERT_TRUE(ended);
+        std::sort(items.begin(), items.end());
+        ASSERT_TRUE(items == vector<int>({ 0, 1, 2, 100, 101 }));
+    }
+
+    TEST(LAsync, StreamsZipTest)
+    {
+        executor ex;
+        vector<int> v = { 10, 20, 30, 40 };
+        vector<pair<int, int>> items;
+        bool ended = false;
+        streams::for_each(streams::zip(async_range(ex, 3), streams::iterate(v.begin(), v.end())),
+            [&](pair<int, int> p) { items.push_back(p); },
+            [&] { ended = true; });
+        ex.execute();
+        ASSERT_TRUE(ended);
+        ASSERT_TRUE((items == vector<pair<int, int>>({ { 0, 10 }, { 1, 20 }, { 2, 30 } })));
+    }
+
+    TEST(LAsync, StreamsPrefetchTest)
+    {
+        executor ex;
+        vector<int> items;
+        bool ended = false;
+        auto ahead = async_range(ex, 10) | streams::prefetch<4>();
+        ex.execute();  // The producer runs ahead of the consumer and fills the channel.
+        streams::for_each(std::move(ahead) | streams::take(6), [&](int x) { items.push_back(x); }, [&] { ended = true; });
+        ASSERT_EQ(items.size(), size_t(4));
+        ex.execute();
+        ASSERT_TRUE(ended);
+        ASSERT_TRUE(items == vector<int>({ 0, 1, 2, 3, 4, 5 }));
+    }
+}
@@ -0,0 +1,216 @@
+#include <atomic>
+using std::atomic;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <chrono>
+
+#include <functional>
+using std::function;
+
+#include <thread>
+
+#include <memory>
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_thread_pool.h"
+using l_async::thread_pool_executor;
+using l_async::concurrent_result;
+using l_async::local_heap;
+using l_async::loop;
+using l_async::spawn;
+using l_async::bind_to;
+
+namespace
+{
+    void fan_out(thread_pool_executor& ex, int depth, concurrent_result<int> result)
+    {
+        *result += 1;
+        if (depth == 0)
+            return;
+        for (int i = 0; i < 4; i++) {
+            ex.schedule([&ex, depth, result] {
+                fan_out(ex, depth - 1, result);
+            });
+        }
+    }
+
+    TEST(LAsync, ThreadPoolFanOutTest)
+    {
+        thread_pool_executor ex(4);
+        int nodes = 0;
+        fan_out(ex, 6, concurrent_result<int>([&](int n) { nodes = n; }));
+        ex.execute();
+        ASSERT_EQ(nodes, (4 * 4 * 4 * 4 * 4 * 4 * 4 - 1) / 3);
+    }
+
+    TEST(LAsync, ThreadPoolLoopTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<bool> ok = false;
+        loop test([&, i = 0, sum = 0](auto next) mutable {
+            ex.schedule([&, next, v = i < 1000 ? optional<int>(i++) : nullopt] {
+                if (v) {
+                    sum += *v;
+                    next();
+                } else {
+                    ok = sum == 999 * 1000 / 2;
+                }
+            });
+        });
+        ex.execute();
+        ASSERT_TRUE(ok.load());
+    }
+
+    TEST(LAsync, ThreadPoolLocalQueueTest)
+    {
+        thread_pool_executor ex(2);
+        atomic<bool> local = false;
+        ex.schedule([&] {
+            size_t home = ex.current_worker_index();
+            ex.schedule([&, home] {
+                local = ex.current_worker_index() < ex.size();
+            });
+            ASSERT_LT(home, ex.size());
+        });
+        ex.execute();
+        ASSERT_TRUE(local.load());
+        ASSERT_EQ(ex.current_worker_index(), ex.size());
+    }
+
+    // Unbalanced tree: node `n` has a chain child `n - 1` and, for even `n`, a bushy subtree of `n / 2` levels with 2 children each.
+    void visit(thread_pool_executor& ex, int n, bool bushy, concurrent_result<int> result)
+    {
+        *result += 1;
+        if (n == 0)
+            return;
+        spawn(ex, result, [&ex, n, bushy](auto& result) { visit(ex, n - 1, bushy, result); });
+        if (bushy || n % 2 == 0)
+            spawn(ex, result, [&ex, n](auto& result) { visit(ex, n / 2 - (n % 2 == 0), true, result); });
+    }
+
+    TEST(LAsync, ThreadPoolSpawnTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<int> nodes = 0;
+        spawn(ex, concurrent_result<int>([&](int n) { nodes = n; }), [&ex](auto& result) {
+            visit(ex, 24, false, result);
+        });
+        ex.execute();
+        // Serial count of the same tree.
+        function<int(int, bool)> count = [&](int n, bool bushy) {
+            return n == 0 ? 1 : 1 + count(n - 1, bushy) + (bushy || n % 2 == 0 ? count(n / 2 - (n % 2 == 0), true) : 0);
+        };
+        ASSERT_EQ(nodes.load(), count(24, false));
+    }
+
+    TEST(LAsync, ThreadPoolSpawnStealTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<size_t> thief = ex.size();
+        atomic<int> done = 0;
+        spawn(ex, concurrent_result<int>([&](int n) { done = n; }), [&](auto& result) {
+            size_t home = ex.current_worker_index();
+            for (int i = 0; i < 8; i++) {
+                spawn(ex, result, [&](auto& result) {
+                    if (ex.current_worker_index() != home)
+                        thief = ex.current_worker_index();
+                    *result += 1;
+                });
+            }
+            // The subtasks are in this worker's deque, others have to steal them while this one is busy.
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (thief.load() == ex.size() && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::yield();
+        });
+        ex.execute();
+        ASSERT_EQ(done.load(), 8);
+        ASSERT_LT(thief.load(), ex.size());
+    }
+
+    void schedule_on_each(thread_pool_executor& ex, atomic<int>& done, atomic<int>& misplaced)
+    {
+        for (size_t i = 0; i < ex.size(); i++) {
+            for (int k = 0; k < 100; k++) {
+                ex.schedule_on(i, [&, i] {
+                    if (ex.current_worker_index() != i)
+                        misplaced++;
+                    done++;
+                });
+            }
+        }
+    }
+
+    TEST(LAsync, ThreadPoolScheduleOnTest)
+    {
+        for (bool pin : { false, true }) {
+            thread_pool_executor ex(4, 16, pin);
+            atomic<int> done = 0, misplaced = 0;
+            schedule_on_each(ex, done, misplaced);  // from outside
+            ex.schedule_on(2, [&] { schedule_on_each(ex, done, misplaced); });  // from a worker, its own tasks included
+            ex.execute();
+            ASSERT_EQ(done.load(), 2 * 4 * 100);
+            ASSERT_EQ(misplaced.load(), 0);
+        }
+    }
+
+    TEST(LAsync, ThreadPoolBindToTest)
+    {
+        thread_pool_executor ex(4);
+        atomic<int> iterations = 0, misplaced = 0;
+        loop bound(bind_to(ex.worker_at(1), [&](auto next) {
+            if (ex.current_worker_index() != 1)
+                misplaced++;
+            if (++iterations < 1000)
+                ex.schedule(next);  // `next` is called on whichever worker takes the task
+        }));
+        ex.execute();
+        ASSERT_EQ(iterations.load(), 1000);
+        ASSERT_EQ(misplaced.load(), 0);
+    }
+
+    TEST(LAsync, LocalHeapTest)
+    {
+        local_heap heap;
+        void* a = heap.allocate(24);
+        void* b = heap.allocate(32);  // same size class
+        void* c = heap.allocate(local_heap::max_block);
+        ASSERT_TRUE(local_heap::owner_of(a) == &heap);
+        ASSERT_TRUE(local_heap::owner_of(c) == &heap);
+        heap.free_local(a, 24);
+        ASSERT_TRUE(heap.allocate(17) == a);
+        std::thread([&] { heap.free_remote(b, 32); }).join();
+        ASSERT_TRUE(heap.allocate(32) == b);  // taken over from the remote list, when the local one is empty
+        heap.free_local(b, 32);
+        heap.free_local(a, 24);
+        heap.free_local(c, local_heap::max_block);
+        for (int i = 0; i < 10000; i++)
+            ASSERT_TRUE(local_heap::owner_of(heap.allocate(64)) == &heap);  // spans many chunks
+    }
+
+    TEST(LAsync, ThreadPoolContextAllocatorTest)
+    {
+        thread_pool_executor ex(4);
+        thread_pool_executor::context_allocator<char> alloc(ex);
+        atomic<int> sum = 0;
+        {
+            l_async::result<int> outside(std::allocator_arg, alloc, [&](int n) { sum += n; }, 1);  // from the shared heap
+            for (int i = 0; i < 1000; i++) {
+                ex.schedule([&, outside] {
+                    // Allocated on this worker, released by the last iteration, that may run on another one.
+                    loop counting(std::allocator_arg, alloc, [&, n = 0](auto next) mutable {
+                        if (++n < 10)
+                            ex.schedule(next);
+                        else
+                            sum++;
+                    });
+                });
+            }
+        }
+        ex.execute();
+        ASSERT_EQ(sum.load(), 1000 + 1);
+    }
+}
@@ -0,0 +1,159 @@
+#include <chrono>
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::hours;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <vector>
+using std::vector;
+
+#include "gunit.h"
+#include "l_async.h"
+#include "l_async_priority_executor.h"
+#include "l_async_timer.h"
+using l_async::loop;
+using l_async::priority;
+using l_async::priority_executor;
+using l_async::slot;
+using l_async::timer_wheel;
+using l_async::with_timeout;
+
+namespace
+{
+    TEST(LAsync, TimerWheelOrderTest)
+    {
+        auto origin = timer_wheel::clock::now();
+        timer_wheel wheel(milliseconds(1), origin);
+        vector<int> fired;
+        // Deadlines on all levels of the wheel and beyond its range.
+        for (int ms : { 70000000, 5000, 3, 300000, 64, 1, 4096, 63, 20000000 })
+            wheel.at(origin + milliseconds(ms), [&fired, ms] { fired.push_back(ms); });
+        auto dropped = wheel.at(origin + milliseconds(10), [&] { fired.push_back(-1); });
+        ASSERT_TRUE(wheel.cancel(dropped));
+        ASSERT_FALSE(wheel.cancel(dropped));
+        ASSERT_EQ(wheel.size(), size_t(9));
+
+        wheel.advance(origin + milliseconds(62));
+        ASSERT_TRUE(fired == vector<int>({ 1, 3 }));
+        wheel.advance(origin + milliseconds(64));
+        ASSERT_TRUE(fired == vector<int>({ 1, 3, 63, 64 }));
+        wheel.advance(origin + milliseconds(4095));
+        ASSERT_EQ(fired.size(), size_t(4));
+        for (auto t = milliseconds(4096); t <= milliseconds(70000000); t += seconds(1))
+            wheel.advance(origin + t);
+        wheel.advance(origin + milliseconds(70000000));
+        ASSERT_TRUE(fired == vector<int>({ 1, 3, 63, 64, 4096, 5000, 300000, 20000000, 70000000 }));
+        ASSERT_TRUE(wheel.empty());
+        ASSERT_FALSE(wheel.next_expiry().has_value());
+    }
+
+    TEST(LAsync, TimerWheelReentrancyTest)
+    {
+        auto origin = timer_wheel::clock::now();
+        timer_wheel wheel(milliseconds(1), origin);
+        int fired = 0;
+        timer_wheel::timer_id first, second;
+        // Whichever fires first cancels the other one due in the same tick.
+        auto on_timer = [&](timer_wheel::timer_id& other) {
+            fired++;
+            ASSERT_TRUE(wheel.cancel(other));
+            wheel.at(origin, [&] { fired += 10; });  // Past deadline fires at the next tick.
+        };
+        first = wheel.at(origin + milliseconds(5), [&] { on_timer(second); });
+        second = wheel.at(origin + milliseconds(5), [&] { on_timer(first); });
+        ASSERT_TRUE(wheel.next_expiry() == origin + milliseconds(5));
+        wheel.advance(origin + milliseconds(5));
+        ASSERT_EQ(fired, 1);
+        wheel.advance(origin + milliseconds(6));
+        ASSERT_EQ(fired, 11);
+    }
+
+    TEST(LAsync, TimerWheelManyTimersTest)
+    {
+        auto origin = timer_wheel::clock::now();
+        timer_wheel wheel(milliseconds(1), origin);
+        vector<timer_wheel::timer_id> ids;
+        int fired = 0;
+        for (int i = 0; i < 100000; i++)
+            ids.push_back(wheel.at(origin + milliseconds(i % 10000 + 1), [&] { fired++; }));
+        for (size_t i = 0; i < ids.size(); i += 2)
+            wheel.cancel(ids[i]);
+        wheel.advance(origin + hours(1));
+        ASSERT_EQ(fired, 50000);
+    }
+
+    TEST(LAsync, ExecutorAfterTest)
+    {
+        priority_executor ex;
+        vector<int> order;
+        auto start = priority_executor::clock::now();
+        {
+            priority_executor::scope client(priority::high);
+            ex.after(milliseconds(20), [&] {
+                ASSERT_TRUE(priority_executor::current_priority() == priority::high);
+                order.push_back(2);
+            });
+        }
+        ex.after(milliseconds(5), [&] { order.push_back(1); });
+        auto never = ex.after(milliseconds(1), [&] { order.push_back(-1); });
+        ASSERT_TRUE(ex.cancel(never));
+        ex.schedule([&] { order.push_back(0); });
+        ex.execute();
+        ASSERT_TRUE(order == vector<int>({ 0, 1, 2 }));
+        ASSERT_TRUE(priority_executor::clock::now() - start >= milliseconds(20));
+    }
+
+    TEST(LAsync, WithTimeoutTest)
+    {
+        priority_executor ex;
+        slot<optional<int>> silent;  // Never answers.
+        slot<optional<int>> numbers;
+        loop providing([&, sink = numbers.get_provider(), i = 0](auto next) mutable {
+            sink.await([&, next] {
+                ex.after(milliseconds(1), [&, next] {
+                    sink(++i);
+                    next();
+                });
+            });
+        });
+        vector<optional<int>> received;
+        auto timed_out = with_timeout(ex, silent, milliseconds(5), [] { return optional<int>(); });
+        auto in_time = with_timeout(ex, numbers, seconds(10), [] { return optional<int>(-1); });
+        timed_out([&](optional<int> v) { received.push_back(v); });
+        in_time([&](optional<int> v) {
+            received.push_back(v);
+            in_time([&](optional<int> v) { received.push_back(v); });
+        });
+        ex.execute();  // Ends, when the timers of answered requests are cancelled.
+        ASSERT_TRUE(received == vector<optional<int>>({ 1, 2, nullopt }));
+    }
+
+    TEST(LAsync, WithTimeoutRetryTest)
+    {
+        priority_executor ex;
+        slot<optional<int>> numbers;
+        loop providing([&, sink = numbers.get_provider(), i = 0](auto next) mutable {
+            sink.await([&, next] {
+                ex.after(milliseconds(i == 0 ? 50 : 1), [&, next] {  // The first answer is late.
+                    sink(++i);
+                    next();
+                });
+            });
+        });
+        vector<optional<int>> received;
+        auto next_number = with_timeout(ex, numbers, milliseconds(20), [] { return optional<int>(); });
+        loop polling([&](auto next) {
+            next_number([&, next](optional<int> v) {
+                received.push_back(v);
+                if (received.size() < 5)
+                    next();  // Requests the same slot again, also after a timeout.
+            });
+        });
+        ex.execute();
+        // Timeouts at 20 and 40 ms, the answer to the first request comes at 50 ms to the third call.
+        ASSERT_TRUE(received == vector<optional<int>>({ nullopt, nullopt, 1, 2, 3 }));
+    }
+}
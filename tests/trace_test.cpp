@@ -0,0 +1,140 @@
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include <sstream>
+using std::ostringstream;
+
+#include <string>
+using std::string;
+
+#include "single_thread_executor.h"
+using executor = testing::single_thread_executor;
+
+#include "gunit.h"
+#include "l_async.h"
+using l_async::loop;
+using l_async::result;
+using l_async::slot;
+using recorder = l_async::trace::recorder;
+
+namespace
+{
+    struct snapshot
+    {
+        int loops_created, loops_destroyed, async_iterations, sync_restarts, results_fired, slot_awaits, slot_deliveries;
+
+        snapshot()
+        {
+            auto& s = recorder::stats();
+            loops_created = int(s.loops_created);
+            loops_destroyed = int(s.loops_destroyed);
+            async_iterations = int(s.async_iterations);
+            sync_restarts = int(s.sync_restarts);
+            results_fired = int(s.results_fired);
+            slot_awaits = int(s.slot_awaits);
+            slot_deliveries = int(s.slot_deliveries);
+        }
+    };
+
+    TEST(LAsync, TraceLoopCountersTest)
+    {
+        executor ex;
+        snapshot before;
+        {
+            loop counting([&, i = 0](auto next) mutable {
+                if (++i == 10)
+                    return;
+                if (i % 2 == 0)
+                    ex.schedule(next);
+                else
+                    next();
+            });
+            ex.execute();
+            ASSERT_EQ(int(recorder::stats().loops_live), 1);
+        }
+        snapshot after;
+        ASSERT_EQ(after.loops_created - before.loops_created, 1);
+        ASSERT_EQ(after.loops_destroyed - before.loops_destroyed, 1);
+        ASSERT_EQ(int(recorder::stats().loops_live), 0);
+        ASSERT_TRUE(recorder::stats().loops_peak >= 1);
+        // Iterations 1, 3, 5, 7, 9 start asynchronously, 2, 4, 6, 8, 10 are restarted synchronously by `next()`.
+        ASSERT_EQ(after.async_iterations - before.async_iterations, 5);
+        ASSERT_EQ(after.sync_restarts - before.sync_restarts, 5);
+    }
+
+    TEST(LAsync, TraceResultAndSlotCountersTest)
+    {
+        executor ex;
+        snapshot before;
+        int total = 0;
+        {
+            slot<optional<int>> numbers;
+            loop producing([&, sink = numbers.get_provider(), i = 0](auto next) mutable {
+                sink.await([&, next] {
+                    ex.schedule([&, next] {
+                        sink(i < 3 ? optional<int>(i++) : nullopt);
+                        next();
+                    });
+                });
+            });
+            result<int> sum([&](int v) { total = v; });
+            loop consuming([&, numbers, sum](auto next) mutable {
+                numbers([&, next](optional<int> v) {
+                    if (v) {
+                        *sum += *v;
+                        next();
+                    }
+                });
+            });
+        }
+        ex.execute();
+        snapshot after;
+        ASSERT_EQ(total, 3);
+        ASSERT_EQ(after.results_fired - before.results_fired, 1);
+        ASSERT_EQ(after.slot_awaits - before.slot_awaits, 4);
+        ASSERT_EQ(after.slot_deliveries - before.slot_deliveries, 4);
+    }
+
+    TEST(LAsync, TraceChromeExportTest)
+    {
+        executor ex;
+        recorder::clear_events();
+        recorder::start_capture();
+        {
+            loop single([&](auto) { ex.schedule([] {}); });
+            ex.execute();
+        }
+        recorder::stop_capture();
+        ostringstream out;
+        recorder::write_chrome_trace(out);
+        recorder::clear_events();
+        string json = out.str();
+        ASSERT_TRUE(json.find("{\"traceEvents\":[") == 0);
+        ASSERT_TRUE(json.find("\"name\":\"loop\",\"cat\":\"l_async\",\"ph\":\"b\"") != string::npos);
+        ASSERT_TRUE(json.find("\"name\":\"loop\",\"cat\":\"l_async\",\"ph\":\"e\"") != string::npos);
+        ASSERT_TRUE(json.find("\"name\":\"loop.async_iteration\"") != string::npos);
+    }
+
+    TEST(LAsync, TraceContextsTest)
+    {
+        auto& s = recorder::stats();
+        uint64_t contexts = s.contexts_live, bytes = s.context_bytes_live;
+        recorder::reset_peaks();
+        {
+            optional<loop> pending;
+            loop waiting([&](auto next) { pending = next; });  // Empty capture, but a pointer to `pending`.
+            ASSERT_EQ(s.contexts_live - contexts, uint64_t(1));
+            ASSERT_TRUE(s.context_bytes_live - bytes <= 64) << "a loop block fits one cache line";
+            slot<int> numbers;
+            ASSERT_EQ(s.contexts_live - contexts, uint64_t(2));
+            ASSERT_TRUE(s.context_bytes_live - bytes <= 128) << "so does a slot block";
+            l_async::arena request_arena(4096);
+            result<int> sum(std::allocator_arg, l_async::arena_allocator<char>(request_arena), [](int) {});
+            ASSERT_EQ(s.contexts_live - contexts, uint64_t(3)) << "blocks from allocators are counted";
+        }
+        ASSERT_EQ(s.contexts_live.load(), contexts);
+        ASSERT_EQ(s.context_bytes_live.load(), bytes);
+        ASSERT_EQ(s.contexts_peak - contexts, uint64_t(3));
+    }
+}
@@ -0,0 +1,72 @@
+#include <memory>
+using std::make_unique;
+using std::unique_ptr;
+
+#include <optional>
+using std::optional;
+using std::nullopt;
+
+#include "single_thread_executor.h"
+#include "gunit.h"
+#include "l_async.h"
+using l_async::unique_function;
+using l_async::slot;
+using l_async::loop;
+
+namespace
+{
+    struct counted
+    {
+        static inline int alive = 0;
+        char padding[100] = {};
+
+        counted() { alive++; }
+        counted(const counted&) { alive++; }
+        ~counted() { alive--; }
+    };
+
+    TEST(LAsync, UniqueFunctionTest)
+    {
+        unique_function<int(int)> inline_fn([p = make_unique<int>(2)](int x) { return x * *p; });
+        unique_function<int(int)> heap_fn([c = counted()](int x) { return x + sizeof(c.padding); });
+        ASSERT_EQ(counted::alive, 1);
+        ASSERT_EQ(inline_fn(21), 42);
+        ASSERT_EQ(heap_fn(1), 101);
+
+        unique_function<int(int)> moved(std::move(heap_fn));
+        ASSERT_FALSE(bool(heap_fn));
+        ASSERT_EQ(moved(2), 102);
+        swap(moved, inline_fn);
+        ASSERT_EQ(moved(1), 2);
+        ASSERT_EQ(inline_fn(1), 101);
+        inline_fn = nullptr;
+        ASSERT_EQ(counted::alive, 0);
+
+        unique_function<void()> empty(std::function<void()>{});
+        ASSERT_FALSE(bool(empty));
+    }
+
+    TEST(LAsync, MoveOnlyListenersTest)
+    {
+        testing::single_thread_executor ex;
+        slot<optional<int>> numbers;
+        loop producer([&ex, sink = numbers.get_provider(), i = make_unique<int>(0)](auto next) mutable {
+            sink.await([&, next, token = make_unique<int>(1)] {
+                ex.schedule([&, next, v = make_unique<int>((*i)++)] {
+                    sink(*v < 3 ? optional<int>(*v) : nullopt);
+                    next();
+                });
+            });
+        });
+        int sum = 0;
+        loop consumer([&, numbers, owned = make_unique<int>(10)](auto next) mutable {
+            numbers([&, next, u = make_unique<int>(1)](auto v) {
+                if (!v) return;
+                sum += *v * *owned;
+                next();
+            });
+        });
+        ex.execute();
+        ASSERT_EQ(sum, 30);
+    }
+}